@@ -62,7 +62,6 @@ bool AssemblyDef::ILHeaderDump(Stream& peLib)
 bool AssemblyDef::PEHeaderDump(Stream& peLib)
 {
     size_t nameIndex = peLib.PEOut().HashString(name_);
-    TableEntryBase* table;
     if (external_)
     {
         size_t blobIndex = 0;
@@ -74,13 +73,12 @@ bool AssemblyDef::PEHeaderDump(Stream& peLib)
                 break;
             }
         }
-        table = new AssemblyRefTableEntry(PA_None, major_, minor_, build_, revision_, nameIndex, blobIndex);
+        peIndex_ = peLib.PEOut().AddTableEntry(AssemblyRefTableEntry(PA_None, major_, minor_, build_, revision_, nameIndex, blobIndex));
     }
     else
     {
-        table = new AssemblyDefTableEntry(PA_None, major_, minor_, build_, revision_, nameIndex);
+        peIndex_ = peLib.PEOut().AddTableEntry(AssemblyDefTableEntry(PA_None, major_, minor_, build_, revision_, nameIndex));
     }
-    peIndex_ = peLib.PEOut().AddTableEntry(table);
     return true;
 }
 Namespace* AssemblyDef::InsertNameSpaces(PELib& lib, std::map<std::string, Namespace*>& nameSpaces, const std::string& name)
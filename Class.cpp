@@ -128,11 +128,10 @@ bool Class::PEDump(Stream& peLib)
             }
             size_t sz;
             Type type(this);
-            Byte* sig = SignatureGenerator::TypeSig(&type, sz);
+            SignatureGenerator generator;
+            Byte* sig = generator.TypeSig(&type, sz);
             size_t signature = peLib.PEOut().HashBlob(sig, sz);
-            delete[] sig;
-            TypeSpecTableEntry* table = new TypeSpecTableEntry(signature);
-            peIndex_ = peLib.PEOut().AddTableEntry(table);
+            peIndex_ = peLib.PEOut().AddTableEntry(TypeSpecTableEntry(signature));
         }
     }
     else if (InAssemblyRef())
@@ -145,8 +144,7 @@ bool Class::PEDump(Stream& peLib)
                 parent_->PEDump(peLib);
                 ResolutionScope resolution(ResolutionScope::TypeRef, parent_->PEIndex());
                 size_t typenameIndex = peLib.PEOut().HashString(Name());
-                TableEntryBase* table = new TypeRefTableEntry(resolution, typenameIndex, 0);
-                peIndex_ = peLib.PEOut().AddTableEntry(table);
+                peIndex_ = peLib.PEOut().AddTableEntry(TypeRefTableEntry(resolution, typenameIndex, 0));
             }
             else
             {
@@ -154,8 +152,7 @@ bool Class::PEDump(Stream& peLib)
                 ResolutionScope resolution(ResolutionScope::AssemblyRef, ParentAssembly(peLib));
                 size_t typenameIndex = peLib.PEOut().HashString(Name());
                 size_t namespaceIndex = ParentNamespace(peLib);
-                TableEntryBase* table = new TypeRefTableEntry(resolution, typenameIndex, namespaceIndex);
-                peIndex_ = peLib.PEOut().AddTableEntry(table);
+                peIndex_ = peLib.PEOut().AddTableEntry(TypeRefTableEntry(resolution, typenameIndex, namespaceIndex));
             }
         }
     }
@@ -180,9 +177,7 @@ bool Class::PEDump(Stream& peLib)
         if (extendsFrom_ && !extendsFrom_->InAssemblyRef())
             typeType = TypeDefOrRef::TypeDef;
         TypeDefOrRef extendsClass(typeType, extends);
-        TableEntryBase* table =
-            new TypeDefTableEntry(peflags, typenameIndex, namespaceIndex, extendsClass, fieldIndex, methodIndex);
-        peIndex_ = peLib.PEOut().AddTableEntry(table);
+        peIndex_ = peLib.PEOut().AddTableEntry(TypeDefTableEntry(peflags, typenameIndex, namespaceIndex, extendsClass, fieldIndex, methodIndex));
 
         if (pack_ > 0 || size_ > 0)
         {
@@ -192,21 +187,18 @@ bool Class::PEDump(Stream& peLib)
                 mypack_ = 1;
             if (mysize_ <= 0)
                 mysize_ = 1;
-            table = new ClassLayoutTableEntry(mypack_, mysize_, peIndex_);
-            peLib.PEOut().AddTableEntry(table);
+            peLib.PEOut().AddTableEntry(ClassLayoutTableEntry(mypack_, mysize_, peIndex_));
         }
         if (parent && typeid(*parent) == typeid(Class))
         {
             size_t enclosing = ParentClass(peLib);
-            table = new NestedClassTableEntry(peIndex_, enclosing);
-            peLib.PEOut().AddTableEntry(table);
+            peLib.PEOut().AddTableEntry(NestedClassTableEntry(peIndex_, enclosing));
         }
         DataContainer::PEDump(peLib);
         if (properties_.size())
         {
             size_t propertyIndex = peLib.PEOut().NextTableIndex(tProperty);
-            table = new PropertyMapTableEntry(peIndex_, propertyIndex);
-            peLib.PEOut().AddTableEntry(table);
+            peLib.PEOut().AddTableEntry(PropertyMapTableEntry(peIndex_, propertyIndex));
             for (auto p : properties_)
                 p->PEDump(peLib);
         }
@@ -219,8 +211,7 @@ bool Class::PEDump(Stream& peLib)
                 name += (char)(i / 26 + 'A');
                 name += (char)(i % 26 + 'A');
                 size_t namestr = peLib.PEOut().HashString(name);
-                table = new GenericParamTableEntry(i, 0, owner, namestr);
-                peLib.PEOut().AddTableEntry(table);
+                peLib.PEOut().AddTableEntry(GenericParamTableEntry(i, 0, owner, namestr));
             }
         }
     }
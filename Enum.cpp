@@ -66,15 +66,12 @@ bool Enum::PEDump(Stream& peLib)
         DataContainer* parent = Parent();
         if (parent && typeid(*parent) == typeid(Class))
             namespaceIndex = 0;
-        TableEntryBase* table =
-            new TypeDefTableEntry(peflags, typenameIndex, namespaceIndex, extendsClass, fieldIndex, methodIndex);
-        peIndex_ = peLib.PEOut().AddTableEntry(table);
+        peIndex_ = peLib.PEOut().AddTableEntry(TypeDefTableEntry(peflags, typenameIndex, namespaceIndex, extendsClass, fieldIndex, methodIndex));
 
         if (parent && typeid(*parent) == typeid(Class))
         {
             size_t enclosing = ParentClass(peLib);
-            table = new NestedClassTableEntry(peIndex_, enclosing);
-            peLib.PEOut().AddTableEntry(table);
+            peLib.PEOut().AddTableEntry(NestedClassTableEntry(peIndex_, enclosing));
         }
         DataContainer::PEDump(peLib);  // should only be the enumerations
         size_t sz;
@@ -98,13 +95,12 @@ bool Enum::PEDump(Stream& peLib)
         // add the value member
         Type type(tsize, 0);
         Field field("value__", &type, Qualifiers(0));
-        Byte* sig = SignatureGenerator::FieldSig(&field, sz);
+        SignatureGenerator generator;
+        Byte* sig = generator.FieldSig(&field, sz);
         size_t sigindex = peLib.PEOut().HashBlob(sig, sz);
         size_t nameindex = peLib.PEOut().HashString(field.Name());
-        table = new FieldTableEntry(FieldTableEntry::Public | FieldTableEntry::SpecialName | FieldTableEntry::RTSpecialName,
-                                    nameindex, sigindex);
-        peIndex_ = peLib.PEOut().AddTableEntry(table);
-        delete[] sig;
+        peIndex_ = peLib.PEOut().AddTableEntry(FieldTableEntry(FieldTableEntry::Public | FieldTableEntry::SpecialName | FieldTableEntry::RTSpecialName,
+                                                               nameindex, sigindex));
     }
     else if (!peIndex_)
     {
@@ -113,16 +109,14 @@ bool Enum::PEDump(Stream& peLib)
             parent_->PEDump(peLib);
             ResolutionScope resolution(ResolutionScope::TypeRef, parent_->PEIndex());
             size_t typenameIndex = peLib.PEOut().HashString(Name());
-            TableEntryBase* table = new TypeRefTableEntry(resolution, typenameIndex, 0);
-            peIndex_ = peLib.PEOut().AddTableEntry(table);
+            peIndex_ = peLib.PEOut().AddTableEntry(TypeRefTableEntry(resolution, typenameIndex, 0));
         }
         else
         {
             ResolutionScope resolution(ResolutionScope::AssemblyRef, ParentAssembly(peLib));
             size_t typenameIndex = peLib.PEOut().HashString(Name());
             size_t namespaceIndex = ParentNamespace(peLib);
-            TableEntryBase* table = new TypeRefTableEntry(resolution, typenameIndex, namespaceIndex);
-            peIndex_ = peLib.PEOut().AddTableEntry(table);
+            peIndex_ = peLib.PEOut().AddTableEntry(TypeRefTableEntry(resolution, typenameIndex, namespaceIndex));
         }
     }
     return true;
@@ -142,15 +142,15 @@ bool Field::PEDump(Stream& peLib)
         if (type_->GetClass()->InAssemblyRef())
             type_->GetClass()->PEDump(peLib);
     }
-    Byte* sig = SignatureGenerator::FieldSig(this, sz);
+    SignatureGenerator generator;
+    Byte* sig = generator.FieldSig(this, sz);
     size_t sigindex = peLib.PEOut().HashBlob(sig, sz);
     size_t nameindex = peIndex_ = peLib.PEOut().HashString(Name());
     if (InAssemblyRef())
     {
         parent_->PEDump(peLib);
         MemberRefParent refParent(MemberRefParent::TypeRef, parent_->PEIndex());
-        TableEntryBase* table = new MemberRefTableEntry(refParent, nameindex, sigindex);
-        peIndex_ = peLib.PEOut().AddTableEntry(table);
+        peIndex_ = peLib.PEOut().AddTableEntry(MemberRefTableEntry(refParent, nameindex, sigindex));
     }
     else
     {
@@ -179,14 +179,12 @@ bool Field::PEDump(Stream& peLib)
                 // should never get here
                 break;
         }
-        TableEntryBase* table = new FieldTableEntry(peflags, nameindex, sigindex);
-        peIndex_ = peLib.PEOut().AddTableEntry(table);
+        peIndex_ = peLib.PEOut().AddTableEntry(FieldTableEntry(peflags, nameindex, sigindex));
 
         if ((parent_->Flags().Flags() & Qualifiers::Explicit) ||
             ((parent_->Flags().Flags() & Qualifiers::Sequential) && explicitOffset_))
         {
-            TableEntryBase* table = new FieldLayoutTableEntry(explicitOffset_, peIndex_);
-            peLib.PEOut().AddTableEntry(table);
+            peLib.PEOut().AddTableEntry(FieldLayoutTableEntry(explicitOffset_, peIndex_));
         }
         Byte buf[8];
         *(longlong*)(buf) = enumValue_;
@@ -221,13 +219,11 @@ bool Field::PEDump(Stream& peLib)
                 // this is NOT compressed like the sigs are...
                 size_t valueIndex = peLib.PEOut().HashBlob(&buf[0], sz);
                 Constant constant(Constant::FieldDef, peIndex_);
-                table = new ConstantTableEntry(type, constant, valueIndex);
-                peLib.PEOut().AddTableEntry(table);
+                peLib.PEOut().AddTableEntry(ConstantTableEntry(type, constant, valueIndex));
                 if (byteValue_ && byteLength_)
                 {
                     size_t valueIndex = peLib.PEOut().RVABytes(byteValue_, byteLength_);
-                    table = new FieldRVATableEntry(valueIndex, peIndex_);
-                    peLib.PEOut().AddTableEntry(table);
+                    peLib.PEOut().AddTableEntry(FieldRVATableEntry(valueIndex, peIndex_));
                 }
             }
             break;
@@ -235,13 +231,11 @@ bool Field::PEDump(Stream& peLib)
                 if (byteValue_ && byteLength_)
                 {
                     size_t valueIndex = peLib.PEOut().RVABytes(byteValue_, byteLength_);
-                    table = new FieldRVATableEntry(valueIndex, peIndex_);
-                    peLib.PEOut().AddTableEntry(table);
+                    peLib.PEOut().AddTableEntry(FieldRVATableEntry(valueIndex, peIndex_));
                 }
                 break;
         }
     }
-    delete[] sig;
     return true;
 }
 }  // namespace DotNetPELib
@@ -0,0 +1,213 @@
+/* Software License Agreement
+ *
+ *     Copyright(C) 1994-2020 David Lindauer, (LADSoft)
+ *     With modifications by me@rochus-keller.ch (2021)
+ *
+ *     This file is part of the Orange C Compiler package.
+ *
+ *     The Orange C Compiler package is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     The Orange C Compiler package is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with Orange C.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *     contact information:
+ *         email: TouchStone222@runbox.com <David Lindauer>
+ *
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <fstream>
+#include <stdio.h>
+#include "PEWriter.h"
+
+#ifndef _WIN32
+static mode_t Umask()
+{
+    // the mask can only be read by setting it, so that is done once
+    static const mode_t mask = []() {
+        mode_t mask = umask(0);
+        umask(mask);
+        return mask;
+    }();
+    return mask;
+}
+#endif
+
+// writes image to a new file in the directory of fileName, which is named in temp
+static bool WriteTempFile(const std::string& fileName, const std::vector<DotNetPELib::Byte>& image, std::string& temp)
+{
+    bool rv = true;
+#ifdef _WIN32
+    // the process id and a counter keep concurrent writers apart, CREATE_NEW anything else
+    static std::atomic<unsigned> counter(0);
+    HANDLE file = INVALID_HANDLE_VALUE;
+    for (int i = 0; i < 100 && file == INVALID_HANDLE_VALUE; i++)
+    {
+        temp = fileName + "." + std::to_string(GetCurrentProcessId()) + "." + std::to_string(counter++) + ".tmp";
+        file = CreateFileA(temp.c_str(), GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE && GetLastError() != ERROR_FILE_EXISTS)
+            return false;
+    }
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    for (size_t pos = 0; rv && pos < image.size();)
+    {
+        DWORD n = 0;
+        rv = ::WriteFile(file, &image[pos], (DWORD)std::min<size_t>(image.size() - pos, 1 << 30), &n, NULL) && n;
+        pos += n;
+    }
+    if (!CloseHandle(file))
+        rv = false;
+#else
+    std::vector<char> name(fileName.begin(), fileName.end());
+    static const char pattern[] = ".XXXXXX";
+    name.insert(name.end(), pattern, pattern + sizeof(pattern));
+    int fd = mkstemp(&name[0]);
+    if (fd < 0)
+        return false;
+    temp = &name[0];
+    // mkstemp makes the file private, it gets the permissions of the file it replaces
+    // or of a newly created one instead
+    struct stat st;
+    rv = fchmod(fd, stat(fileName.c_str(), &st) == 0 ? st.st_mode & 07777 : 0666 & ~Umask()) == 0;
+    for (size_t pos = 0; rv && pos < image.size();)
+    {
+        ssize_t n = write(fd, &image[pos], image.size() - pos);
+        if (n < 0 && errno == EINTR)
+            continue;
+        rv = n > 0;
+        if (rv)
+            pos += n;
+    }
+    if (close(fd) != 0)
+        rv = false;
+#endif
+    if (!rv)
+        remove(temp.c_str());
+    return rv;
+}
+
+bool DotNetPELib::PEWriter::WriteFile(int corFlags, const std::string& fileName)
+{
+    CalculateObjects(corFlags);
+    const size_t size = ImageSize();
+    bool mapped = false;
+    bool rv = false;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    // setting the end of the file allocates it, so a full disk fails here and not
+    // while the view is written
+    LARGE_INTEGER end;
+    end.QuadPart = size;
+    HANDLE mapping = NULL;
+    if (SetFilePointerEx(file, end, NULL, FILE_BEGIN) && SetEndOfFile(file))
+        mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32),
+                                     (DWORD)size, NULL);
+    if (mapping)
+    {
+        Byte* image = (Byte*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+        if (image)
+        {
+            mapped = true;
+            rv = WriteImage(image);
+            // the pages go to the disk in the background, a full disk was caught above
+            if (!UnmapViewOfFile(image))
+                rv = false;
+        }
+        CloseHandle(mapping);
+    }
+    if (!CloseHandle(file))
+        rv = false;
+#else
+    int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+        return false;
+    // the blocks are allocated up front: writing a page of a sparse file on a full
+    // disk raises SIGBUS, where this just fails
+#ifdef __APPLE__
+    fstore_t store = { F_ALLOCATEALL, F_PEOFPOSMODE, 0, (off_t)size, 0 };
+    const bool allocated = fcntl(fd, F_PREALLOCATE, &store) != -1 && ftruncate(fd, size) == 0;
+#else
+    const bool allocated = posix_fallocate(fd, 0, size) == 0;
+#endif
+    if (allocated)
+    {
+        void* image = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (image != MAP_FAILED)
+        {
+            mapped = true;
+            rv = WriteImage((Byte*)image);
+            // the pages go to the disk in the background, a full disk was caught above
+            if (munmap(image, size) != 0)
+                rv = false;
+        }
+    }
+    if (close(fd) != 0)
+        rv = false;
+#endif
+    if (!mapped)
+    {
+        // the file system doesn't support mapping, fall back to a single buffered write
+        std::ofstream out(fileName.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        rv = WriteBuffered(out);
+    }
+    // the file was truncated already, so one which could not be completely written is removed
+    if (!rv)
+        remove(fileName.c_str());
+    return rv;
+}
+
+bool DotNetPELib::PEWriter::PublishFile(const std::string& fileName, const std::vector<Byte>& image)
+{
+    {
+        // the size decides most cases, only equal sizes are compared byte by byte
+        std::ifstream in(fileName.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+        if (in && (size_t)in.tellg() == image.size())
+        {
+            in.seekg(0);
+            bool same = true;
+            char buf[65536];
+            for (size_t pos = 0; same && pos < image.size(); pos += sizeof(buf))
+            {
+                size_t n = image.size() - pos < sizeof(buf) ? image.size() - pos : sizeof(buf);
+                same = in.read(buf, n) && !memcmp(buf, &image[pos], n);
+            }
+            if (same)
+                return true;
+        }
+    }
+    std::string temp;
+    if (!WriteTempFile(fileName, image, temp))
+        return false;
+#ifdef _WIN32
+    if (!MoveFileExA(temp.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING))
+#else
+    if (rename(temp.c_str(), fileName.c_str()) != 0)
+#endif
+    {
+        remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
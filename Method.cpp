@@ -168,7 +168,6 @@ bool Method::PEDump(Stream& peLib)
         size_t sz;
         size_t methodSignature = 0;
         Byte* sig = nullptr;
-        TableEntryBase* table;
         if( prototype_->ReturnType() )
         {
             if ( prototype_->ReturnType()->GetBasicType() == Type::ClassRef)
@@ -218,10 +217,10 @@ bool Method::PEDump(Stream& peLib)
                     }
                 }
             }
-            sig = SignatureGenerator::LocalVarSig(this, sz);
+            SignatureGenerator generator;
+            sig = generator.LocalVarSig(this, sz);
             methodSignature = peLib.PEOut().HashBlob(sig, sz);
-            table = new StandaloneSigTableEntry(methodSignature);
-            methodSignature = peLib.PEOut().AddTableEntry(table);
+            methodSignature = peLib.PEOut().AddTableEntry(StandaloneSigTableEntry(methodSignature));
         }
         Instruction* last = nullptr;
         if (instructions_.size())
@@ -251,7 +250,6 @@ bool Method::PEDump(Stream& peLib)
             peLib.PEOut().AddMethod(rendering_);
             peLib.addMethod(this);
         }
-        delete[] sig;
 
         int implFlags = 0;
         int MFlags = 0;
@@ -289,20 +287,18 @@ bool Method::PEDump(Stream& peLib)
             importNameIndex = peLib.PEOut().HashString(importName_);
         size_t paramIndex = peLib.PEOut().NextTableIndex(tParam);
 
-        sig = SignatureGenerator::MethodDefSig(prototype_, sz);
+        SignatureGenerator generator;
+        sig = generator.MethodDefSig(prototype_, sz);
         methodSignature = peLib.PEOut().HashBlob(sig, sz);
-        delete[] sig;
 
-        table = new MethodDefTableEntry(rendering_, implFlags, MFlags, nameIndex, methodSignature, paramIndex);
-        prototype_->PEIndex(peLib.PEOut().AddTableEntry(table));
+        prototype_->PEIndex(peLib.PEOut().AddTableEntry(MethodDefTableEntry(rendering_, implFlags, MFlags, nameIndex, methodSignature, paramIndex)));
         int i = 1;
         size_t lastParamIndex = 0;
         for (auto it = prototype_->begin(); it != prototype_->end(); ++it)
         {
             int flags = 0;
             size_t nameIndex = peLib.PEOut().HashString((*it)->Name());
-            TableEntryBase* table = new ParamTableEntry(flags, i++, nameIndex);
-            lastParamIndex = peLib.PEOut().AddTableEntry(table);
+            lastParamIndex = peLib.PEOut().AddTableEntry(ParamTableEntry(flags, i++, nameIndex));
         }
 
         if (invokeMode_ == PInvoke)
@@ -317,13 +313,11 @@ bool Method::PEDump(Stream& peLib)
             size_t moduleRef = peLib.moduleRefs[moduleName];
             if (moduleRef == 0)
             {
-                TableEntryBase* table = new ModuleRefTableEntry(moduleName);
-                moduleRef = peLib.PEOut().AddTableEntry(table);
+                moduleRef = peLib.PEOut().AddTableEntry(ModuleRefTableEntry(moduleName));
                 peLib.moduleRefs[moduleName] = moduleRef;
             }
             MemberForwarded methodIndex(MemberForwarded::MethodDef, prototype_->PEIndex());
-            ImplMapTableEntry* table = new ImplMapTableEntry(Flags, methodIndex, importNameIndex, moduleRef);
-            peLib.PEOut().AddTableEntry(table);
+            peLib.PEOut().AddTableEntry(ImplMapTableEntry(Flags, methodIndex, importNameIndex, moduleRef));
         }
         if ((prototype_->Flags() & MethodSignature::Vararg) && (prototype_->Flags() & MethodSignature::Managed))
         {
@@ -347,8 +341,7 @@ bool Method::PEDump(Stream& peLib)
             }
             CustomAttribute attribute(CustomAttribute::ParamDef, lastParamIndex);
             CustomAttributeType type(CustomAttributeType::MethodRef, attributeType);
-            TableEntryBase* table = new CustomAttributeTableEntry(attribute, type, attributeData);
-            peLib.PEOut().AddTableEntry(table);
+            peLib.PEOut().AddTableEntry(CustomAttributeTableEntry(attribute, type, attributeData));
         }
     }
     return true;
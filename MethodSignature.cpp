@@ -304,12 +304,11 @@ bool MethodSignature::PEDump(Stream& peLib, bool asType)
             if (generic_.size())
             {                
                 genericParent_->PEDump(peLib, false);
-                Byte* sig = SignatureGenerator::MethodSpecSig(this, sz);
+                SignatureGenerator generator;
+                Byte* sig = generator.MethodSpecSig(this, sz);
                 size_t methodSignature = peLib.PEOut().HashBlob(sig, sz);
-                delete[] sig;
                 MethodDefOrRef methodRef(MethodDefOrRef::MemberRef, genericParent_->PEIndexCallSite());
-                TableEntryBase* table = new MethodSpecTableEntry(methodRef, methodSignature);
-                peIndexCallSite_ = peLib.PEOut().AddTableEntry(table);
+                peIndexCallSite_ = peLib.PEOut().AddTableEntry(MethodSpecTableEntry(methodRef, methodSignature));
             }
             else
             {
@@ -319,12 +318,11 @@ bool MethodSignature::PEDump(Stream& peLib, bool asType)
                 {
                     cls = static_cast<Class*>(container_);
                 }
-                Byte* sig = SignatureGenerator::MethodRefSig(this, sz);
+                SignatureGenerator generator;
+                Byte* sig = generator.MethodRefSig(this, sz);
                 size_t methodSignature = peLib.PEOut().HashBlob(sig, sz);
-                delete[] sig;
                 MemberRefParent memberRef(cls && cls->Generic().size() ? MemberRefParent::TypeSpec : MemberRefParent::TypeRef, container_->PEIndex());
-                TableEntryBase* table = new MemberRefTableEntry(memberRef, function, methodSignature);
-                peIndexCallSite_ = peLib.PEOut().AddTableEntry(table);
+                peIndexCallSite_ = peLib.PEOut().AddTableEntry(MemberRefTableEntry(memberRef, function, methodSignature));
             }
         }
     }
@@ -333,11 +331,10 @@ bool MethodSignature::PEDump(Stream& peLib, bool asType)
         if (!peIndexType_)
         {
             size_t sz;
-            Byte* sig = SignatureGenerator::MethodRefSig(this, sz);
+            SignatureGenerator generator;
+            Byte* sig = generator.MethodRefSig(this, sz);
             size_t methodSignature = peLib.PEOut().HashBlob(sig, sz);
-            delete[] sig;
-            TableEntryBase* table = new StandaloneSigTableEntry(methodSignature);
-            peIndexType_ = peLib.PEOut().AddTableEntry(table);
+            peIndexType_ = peLib.PEOut().AddTableEntry(StandaloneSigTableEntry(methodSignature));
         }
     }
     else if ((flags_ & Vararg) && !(flags_ & Managed))
@@ -345,11 +342,11 @@ bool MethodSignature::PEDump(Stream& peLib, bool asType)
         size_t sz;
         size_t function = peLib.PEOut().HashString(name_);
         size_t parentIndex = methodParent_ ? methodParent_->PEIndex() : 0;
-        Byte* sig = SignatureGenerator::MethodRefSig(this, sz);
+        SignatureGenerator generator;
+        Byte* sig = generator.MethodRefSig(this, sz);
         size_t methodSignature = peLib.PEOut().HashBlob(sig, sz);
-        delete[] sig;
         peIndexCallSite_ = peLib.PEOut().AddTableEntry(
-                    new MemberRefTableEntry(
+                    MemberRefTableEntry(
                         MemberRefParent(MemberRefParent::MethodDef, parentIndex),
                         function, methodSignature) );
     }
@@ -399,11 +396,10 @@ bool MethodSignature::PEDump(Stream& peLib, bool asType)
             return false;
         }
         MemberRefParent memberRef(methodreftype, parent);
-        Byte* sig = SignatureGenerator::MethodRefSig(this, sz);
+        SignatureGenerator generator;
+        Byte* sig = generator.MethodRefSig(this, sz);
         size_t methodSignature = peLib.PEOut().HashBlob(sig, sz);
-        delete[] sig;
-        TableEntryBase* table = new MemberRefTableEntry(memberRef, function, methodSignature);
-        peIndexCallSite_ = peLib.PEOut().AddTableEntry(table);
+        peIndexCallSite_ = peLib.PEOut().AddTableEntry(MemberRefTableEntry(memberRef, function, methodSignature));
     }
     return true;
 }
@@ -231,29 +231,16 @@ size_t Operand::Render(Stream& peLib, int opcode, int operandType, Byte* result)
 #ifdef QT_CORE_LIB
             QString str = QString::fromUtf8(stringValue_.c_str());
             str.replace("\\0",QChar('\0'));
-            int size = str.size()+1;
-            wchar_t* buf = new wchar_t[size];
-            str.toWCharArray(buf);
-            buf[size-1] = 0;
+            // utf16() includes the terminating \0
+            size_t usIndex = peLib.PEOut().HashUS(str.utf16(), str.size() + 1);
 #else
-            std::string str = stringValue_;
-            int size = str.size();
-            if( str[size-1] == '0' && str[size-2] == '\\' )
-            {
-                str[size-2] = 0;
-                // size includes "\0"
-                size--;
-            }else
-                size++;
-            wchar_t* buf = new wchar_t[size];
-            for (int i = 0; i < size; i++)
-                buf[i] = str.c_str()[i];
-
+            int size = stringValue_.size();
+            if( size >= 2 && stringValue_[size-1] == '0' && stringValue_[size-2] == '\\' )
+                size -= 2; // HashUS supplies the \0
+            size_t usIndex = peLib.PEOut().HashUS(stringValue_.c_str(), size); // original was std::wstring which choped the explicit \0
 #endif
-            size_t usIndex = peLib.PEOut().HashUS(buf,size); // original was std::wstring which choped the explicit \0
             *(int*)(result) = usIndex | (0x70 << 24);
             sz += 4;
-            delete[] buf;
             break;
         }
     }
@@ -38,7 +38,9 @@
 #include "Property.h"
 #include "PELibError.h"
 #include <cassert>
+#include <cstdio>
 #include <fstream>
+#include <sstream>
 
 #define OBJECT_FILE_VERSION "100"
 
@@ -50,6 +52,10 @@ static PELib* s_this = 0;
 extern std::string DIR_SEP;
 PELib::PELib(const std::string& AssemblyName, int CoreFlags) :
     corFlags_(CoreFlags),
+    deterministic_(false),
+    pe32Plus_(false),
+    compactStrings_(false),
+    hotReload_(false),
     codeContainer_(nullptr),
     objInputBuf_(nullptr),
     objInputSize_(0),
@@ -85,8 +91,22 @@ AssemblyDef* PELib::EmptyWorkingAssembly(const std::string& AssemblyName)
     assemblyRefs_.push_front(assemblyRef);
     return assemblyRef;
 }
-bool PELib::DumpOutputFile(const std::string& file, OutputMode mode, bool gui)
+static std::string ModuleName(const std::string& file)
 {
+    size_t npos = file.find_last_of("\\");
+    if (npos != std::string::npos && npos != file.size() - 1)
+        return file.substr(npos + 1);
+    return file;
+}
+bool PELib::DumpOutputFile(const std::string& file, OutputMode mode, bool gui, bool keepIdentical)
+{
+    if (keepIdentical)
+    {
+        std::vector<Byte> image;
+        if (!DumpOutputImage(file, mode, gui, image))
+            return false;
+        return PEWriter::PublishFile(mode == ilasm ? file : ModuleName(file), image);
+    }
     bool rv;
     switch (mode)
     {
@@ -105,6 +125,67 @@ bool PELib::DumpOutputFile(const std::string& file, OutputMode mode, bool gui)
     }
     return rv;
 }
+bool PELib::DumpOutputImage(const std::string& file, OutputMode mode, bool gui, std::vector<Byte>& image)
+{
+    bool rv = false;
+    switch (mode)
+    {
+        case ilasm:
+        {
+            std::stringstream* out = new std::stringstream;
+            Stream s(out);
+            rv = ILSrcDumpHeader(s) && ILSrcDumpFile(s);
+            const std::string str = out->str();
+            image.assign(str.begin(), str.end());
+            break;
+        }
+        case peexe:
+        case pedll:
+        {
+            std::unique_ptr<PEWriter> peWriter(new PEWriter(mode == peexe, gui, WorkingAssembly()->SNKFile()));
+            peWriter->PE32Plus(pe32Plus_);
+            rv = DumpPEModule(*peWriter, ModuleName(file));
+            if (!peWriter->WriteFile(GetCorFlags(), image))
+                rv = false;
+            if (deterministic_)
+                peWriter->GetGuid(1, moduleGuid);
+            peWriter->GetStatistics(statistics_);
+            if (hotReload_)
+                baseline_ = std::make_shared<PEBaseline>(peWriter.release(), ModuleName(file));
+            break;
+        }
+        default:
+            break;
+    }
+    return rv;
+}
+std::future<bool> PELib::DumpOutputFileAsync(const std::string& file, OutputMode mode, bool gui, bool keepIdentical)
+{
+    std::shared_ptr<std::vector<Byte> > image(new std::vector<Byte>);
+    if (!DumpOutputImage(file, mode, gui, *image))
+    {
+        std::promise<bool> failed;
+        failed.set_value(false);
+        return failed.get_future();
+    }
+    const std::string target = mode == ilasm ? file : ModuleName(file);
+    return std::async(std::launch::async, [target, image, keepIdentical]() -> bool {
+        if (keepIdentical)
+            return PEWriter::PublishFile(target, *image);
+        std::ofstream out(target.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!out)
+            return false;
+        if (!image->empty())
+            out.write((const char*)&(*image)[0], image->size());
+        out.close();
+        if (out.fail())
+        {
+            remove(target.c_str());
+            return false;
+        }
+        return true;
+    });
+}
 AssemblyDef* PELib::AddExternalAssembly(const std::string& assemblyName, Byte* publicKeyToken)
 {
     AssemblyDef* assemblyRef = new AssemblyDef(assemblyName, true, publicKeyToken);
@@ -127,6 +208,16 @@ void PELib::AddPInvokeWithVarargs(MethodSignature* methodsig)
 {
     pInvokeReferences_.insert(std::pair<std::string, MethodSignature *>(methodsig->Name(), methodsig));
 }
+void PELib::AddManifestResource(const std::string& name, const std::string& path, bool isPublic)
+{
+    ManifestResource resource = { name, path, nullptr, 0, isPublic };
+    manifestResources_.push_back(resource);
+}
+void PELib::AddManifestResource(const std::string& name, const Byte* data, size_t size, bool isPublic)
+{
+    ManifestResource resource = { name, std::string(), data, size, isPublic };
+    manifestResources_.push_back(resource);
+}
 Method* PELib::FindPInvoke(const std::string& name) const
 {
     auto it = pInvokeSignatures_.find(name);
@@ -492,8 +583,17 @@ bool PELib::ILSrcDumpFile(Stream& s)
 bool PELib::ILSrcDump(const std::string& file)
 {
     Stream s(new std::fstream(file.c_str(), std::ios::in | std::ios::out | std::ios::trunc | std::ios::in) );
-    const bool res = ILSrcDumpHeader(s) && ILSrcDumpFile(s);
-    static_cast<std::fstream&>( s.Out() ).close();
+    std::fstream& out = static_cast<std::fstream&>( s.Out() );
+    if (!out.is_open())
+        return false;
+    bool res = ILSrcDumpHeader(s) && ILSrcDumpFile(s);
+    out.close();
+    // the source is written while it is rendered, so a failure leaves no file rather than half of one
+    if (!res || out.fail())
+    {
+        remove(file.c_str());
+        res = false;
+    }
     return res;
 }
 
@@ -510,12 +610,40 @@ AssemblyDef* PELib::FindAssembly(const std::string& assemblyName) const
 
 
 bool PELib::DumpPEFile(std::string file, bool isexe, bool isgui)
+{
+    file = ModuleName(file);
+    std::unique_ptr<PEWriter> peWriter(new PEWriter(isexe, isgui, WorkingAssembly()->SNKFile()));
+    peWriter->PE32Plus(pe32Plus_);
+    // a module which cannot be rendered leaves the file alone, as with keepIdentical
+    if (!DumpPEModule(*peWriter, file) || !peWriter->WriteFile(GetCorFlags(), file))
+        return false;
+    if (deterministic_)
+        peWriter->GetGuid(1, moduleGuid);
+    peWriter->GetStatistics(statistics_);
+    if (hotReload_)
+        baseline_ = std::make_shared<PEBaseline>(peWriter.release(), file);
+    return true;
+}
+
+bool PELib::DumpDelta(PEBaseline& baseline, std::vector<Byte>& metadata, std::vector<Byte>& il)
+{
+    hotReload_ = true;
+    std::unique_ptr<PEWriter> peWriter(new PEWriter(true, false, ""));
+    peWriter->Continue(*baseline.writer_);
+    bool rv = DumpPEModule(*peWriter, baseline.moduleName_);
+    if (!peWriter->WriteDelta(*baseline.writer_, metadata, il))
+        rv = false;
+    // the baseline moves on only when the delta could be written
+    if (rv)
+        baseline.writer_.swap(peWriter);
+    return rv;
+}
+
+bool PELib::DumpPEModule(PEWriter& peWriter, const std::string& file)
 {
     int n = 1;
     WorkingAssembly()->Number(n);  // give initial PE Indexes for field resolution..
 
-    PEWriter peWriter(isexe, isgui, WorkingAssembly()->SNKFile());
-
     // RK: Unhandled Exception on Mono 3 and 5:
     // System.TypeLoadException: Could not load type 'Module' from assembly 'test6, Version=0.0.0.0, Culture=neutral,
     // PublicKeyToken=null'.
@@ -524,12 +652,11 @@ bool PELib::DumpPEFile(std::string file, bool isexe, bool isgui)
     size_t moduleIndex = peWriter.HashString("<Module>"); // RK fix: "<Module>" instead of "Module" fixes the issue
 
     TypeDefOrRef typeDef(TypeDefOrRef::TypeDef, 0);
-    TableEntryBase* table = new TypeDefTableEntry(0, moduleIndex, 0, typeDef, 1, 1);
-    peWriter.AddTableEntry(table);
+    peWriter.AddTableEntry(TypeDefTableEntry(0, moduleIndex, 0, typeDef, 1, 1));
 
     int baseTypes = 0;
     WorkingAssembly()->BaseTypes(baseTypes);
-    if (baseTypes)
+    if (baseTypes || hotReload_)
     {
         MSCorLibAssembly();
     }
@@ -568,8 +695,7 @@ bool PELib::DumpPEFile(std::string file, bool isexe, bool isgui)
         if (baseTypes & DataContainer::basetypeObject)
         {
             Resource* result = nullptr;
-            table = new TypeRefTableEntry(rs, objectIndex, systemIndex);
-            objectIndex = peWriter.AddTableEntry(table);
+            objectIndex = peWriter.AddTableEntry(TypeRefTableEntry(rs, objectIndex, systemIndex));
             Find("[mscorlib]System::Object", &result);
             if (result)
                 static_cast<Class*>(result)->PEIndex(objectIndex);
@@ -577,8 +703,7 @@ bool PELib::DumpPEFile(std::string file, bool isexe, bool isgui)
         if (baseTypes & DataContainer::basetypeValue)
         {
             Resource* result = nullptr;
-            table = new TypeRefTableEntry(rs, valueIndex, systemIndex);
-            valueIndex = peWriter.AddTableEntry(table);
+            valueIndex = peWriter.AddTableEntry(TypeRefTableEntry(rs, valueIndex, systemIndex));
             Find("[mscorlib]System::ValueType", &result);
             if (result)
                 static_cast<Class*>(result)->PEIndex(valueIndex);
@@ -586,22 +711,39 @@ bool PELib::DumpPEFile(std::string file, bool isexe, bool isgui)
         if (baseTypes & DataContainer::basetypeEnum)
         {
             Resource* result = nullptr;
-            table = new TypeRefTableEntry(rs, enumIndex, systemIndex);
-            enumIndex = peWriter.AddTableEntry(table);
+            enumIndex = peWriter.AddTableEntry(TypeRefTableEntry(rs, enumIndex, systemIndex));
             Find("[mscorlib]System::Enum", &result);
             if (result)
                 static_cast<Class*>(result)->PEIndex(enumIndex);
         }
         peWriter.SetBaseClasses(objectIndex, valueIndex, enumIndex, systemIndex);
     }
-    size_t npos = file.find_last_of("\\");
-    if (npos != std::string::npos && npos != file.size() - 1)
-        file = file.substr(npos + 1);
+    if (hotReload_)
+    {
+        // [assembly: DebuggableAttribute(true, true)], with JIT optimization disabled
+        ResolutionScope rs(ResolutionScope::AssemblyRef, MSCorLibAssembly()->PEIndex());
+        size_t typeIndex = peWriter.AddTableEntry(
+            TypeRefTableEntry(rs, peWriter.HashString("DebuggableAttribute"), peWriter.HashString("System.Diagnostics")));
+        static Byte ctorSig[] = { 0x20, 2, ELEMENT_TYPE_VOID, ELEMENT_TYPE_bool, ELEMENT_TYPE_bool };
+        MemberRefParent parent(MemberRefParent::TypeRef, typeIndex);
+        size_t ctorIndex = peWriter.AddTableEntry(
+            MemberRefTableEntry(parent, peWriter.HashString(".ctor"), peWriter.HashBlob(ctorSig, sizeof(ctorSig))));
+        static Byte arguments[] = { 1, 0, 1, 1, 0, 0 };
+        CustomAttribute attribute(CustomAttribute::Assembly, 1);
+        CustomAttributeType type(CustomAttributeType::MethodRef, ctorIndex);
+        peWriter.AddTableEntry(
+            CustomAttributeTableEntry(attribute, type, peWriter.HashBlob(arguments, sizeof(arguments))));
+    }
     size_t nameIndex = peWriter.HashString(file);
-    peWriter.CreateGuid(moduleGuid);
+    if (deterministic_)
+        memset(moduleGuid, 0, sizeof(moduleGuid));
+    else
+        peWriter.CreateGuid(moduleGuid);
     size_t guidIndex = peWriter.HashGUID(moduleGuid);
-    table = new ModuleTableEntry(nameIndex, guidIndex);
-    peWriter.AddTableEntry(table);
+    if (deterministic_)
+        peWriter.Deterministic(guidIndex);
+    peWriter.CompactStrings(compactStrings_);
+    peWriter.AddTableEntry(ModuleTableEntry(nameIndex, guidIndex));
 
     for (auto signature : pInvokeSignatures_)
     {
@@ -610,8 +752,14 @@ bool PELib::DumpPEFile(std::string file, bool isexe, bool isgui)
     bool rv = WorkingAssembly()->PEDump(s);
     WorkingAssembly()->Compile(s);
 
-    std::fstream out(file.c_str(), std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
-    peWriter.WriteFile(GetCorFlags(), out);
+    for (const ManifestResource& resource : manifestResources_)
+    {
+        DWord flags = resource.isPublic ? ManifestResourceTableEntry::Public : ManifestResourceTableEntry::Private;
+        if (resource.path.empty())
+            peWriter.AddManifestResource(resource.name, flags, resource.data, resource.size);
+        else
+            peWriter.AddManifestResource(resource.name, flags, resource.path);
+    }
     return rv;
 }
 
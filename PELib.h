@@ -31,6 +31,7 @@
 #include <deque>
 #include <map>
 #include <list>
+#include <future>
 #include "Stream.h"
 // reference changelog.txt to see what the changes are
 //
@@ -106,6 +107,7 @@ namespace DotNetPELib
     typedef long long longlong;
     typedef unsigned char Byte; /* 1 byte */
     class PEWriter;
+    class PEBaseline;
     class AssemblyDef;
     class Class;
     class MethodSignature;
@@ -122,6 +124,40 @@ namespace DotNetPELib
     // TODO: the PEDump implementation still has issues (e.g. redundant calls to PEDump out in the tree leading to
     // redundant types with different IDs and thus runtime exceptions because of "wrong" signatures)
 
+    ///** where the bytes of a written image went, see PELib::Statistics
+    struct PEStatistics
+    {
+        PEStatistics() : tinyMethods(0), tinyBytes(0), fatMethods(0), fatBytes(0) { }
+        struct Table
+        {
+            int table;
+            const char *name;
+            size_t rows;
+            size_t bytes;  // rows times the encoded size of a row
+        };
+        struct Heap
+        {
+            const char *name;
+            size_t bytes;
+            bool wide;      // offsets into the heap take four bytes
+            size_t added;   // entries put into the heap, 0 for #GUID
+            size_t shared;  // how many of those were found there already
+        };
+        struct Index
+        {
+            const char *name;
+            bool wide;            // columns of this kind take four bytes
+            const char *trigger;  // the table or heap too large for two bytes
+        };
+        std::vector<Table> tables;    // the tables that have rows
+        std::vector<Heap> heaps;      // #Strings, #US, #GUID and #Blob
+        std::vector<Index> indexes;   // every kind of index column
+        // method bodies with tiny and fat headers, the bytes include the
+        // exception sections and the alignment up to the next body
+        size_t tinyMethods, tinyBytes;
+        size_t fatMethods, fatBytes;
+    };
+
     ///** this is the main class to instantiate
     // the constructor creates a working assembly, you put all your code and data into that
     class PELib
@@ -178,14 +214,65 @@ namespace DotNetPELib
             pInvokeSignatures_.erase(name);
         }
         Method *FindPInvoke(const std::string& name) const;
+
+        ///** embed a managed resource; the file at path is read when the output is written
+        void AddManifestResource(const std::string& name, const std::string& path, bool isPublic = true);
+        ///** embed a managed resource from memory owned by the caller, which must
+        // stay valid until the output is written. data may only be null if size is 0
+        void AddManifestResource(const std::string& name, const Byte *data, size_t size, bool isPublic = true);
         MethodSignature *FindPInvokeWithVarargs(const std::string& name, std::vector<Param *>&vargs) const;
 
         // get the core flags
         int GetCorFlags() const { return corFlags_; }
 
+        ///** deterministic output: the timestamp and the module guid are derived from
+        // a hash of the metadata and IL, so identical input gives identical files
+        void Deterministic(bool deterministic) { deterministic_ = deterministic; }
+        bool Deterministic() const { return deterministic_; }
+
+        ///** write a 64 bit (PE32+) image for AMD64 instead of a 32 bit one,
+        // the bits32 flag is ignored then
+        void PE32Plus(bool pe32Plus) { pe32Plus_ = pe32Plus; }
+        bool PE32Plus() const { return pe32Plus_; }
+
+        ///** share the bytes of names which end another name in the #Strings heap,
+        // e.g. Value is stored as the tail of get_Value
+        void CompactStrings(bool compactStrings) { compactStrings_ = compactStrings; }
+        bool CompactStrings() const { return compactStrings_; }
+
+        ///** keep what is needed to write later generations of the module as deltas:
+        // the assembly is marked debuggable, the runtime applies deltas only to code it
+        // does not optimize, and the module written next becomes Baseline()
+        void HotReload(bool hotReload) { hotReload_ = hotReload; }
+        bool HotReload() const { return hotReload_; }
+        std::shared_ptr<PEBaseline> Baseline() const { return baseline_; }
+
+        ///** write how the module of this PELib differs from the one of baseline as the
+        // metadata and IL deltas MetadataUpdater.ApplyUpdate takes, and make it the baseline
+        // of the next generation. Method bodies may change and rows may be added after those
+        // of the baseline; other changes throw NotSupported. Turns HotReload on
+        bool DumpDelta(PEBaseline& baseline, std::vector<Byte>& metadata, std::vector<Byte>& il);
+
+        ///** table, heap and method body sizes of the image written last
+        const PEStatistics& Statistics() const { return statistics_; }
+
         ///** write an output file, possibilities are a .il file, an EXE or a DLL
         // the file can also be tagged as either console or win32
-        bool DumpOutputFile(const std::string& fileName, OutputMode mode, bool Gui);
+        // with keepIdentical an existing file with exactly the same contents is left
+        // alone (time stamp included), otherwise it is replaced atomically.
+        // A module which cannot be rendered leaves an existing file as it was.  A file
+        // which cannot be completely written is never left behind: with keepIdentical
+        // the old file stays, otherwise it has been truncated already and is removed
+        bool DumpOutputFile(const std::string& fileName, OutputMode mode, bool Gui, bool keepIdentical = false);
+
+        ///** like DumpOutputFile, but the output goes to image instead of the file system
+        // fileName only names the module
+        bool DumpOutputImage(const std::string& fileName, OutputMode mode, bool Gui, std::vector<Byte>& image);
+
+        ///** like DumpOutputFile, but only the image is built right away, a background thread
+        // writes it out. The PELib instance is free for the next module once this returns
+        std::future<bool> DumpOutputFileAsync(const std::string& fileName, OutputMode mode, bool Gui,
+                                              bool keepIdentical = false);
 
         const std::string &FileName() const { return fileName_; }
 
@@ -220,13 +307,29 @@ namespace DotNetPELib
         bool ILSrcDumpHeader(Stream&);
         bool ILSrcDumpFile(Stream&);
         bool DumpPEFile(std::string name, bool isexe, bool isgui);
+        bool DumpPEModule(PEWriter& peWriter, const std::string& name);
         std::list<AssemblyDef *>assemblyRefs_;
         std::map<std::string, Method *>pInvokeSignatures_;
         std::multimap<std::string, MethodSignature *> pInvokeReferences_;
+        struct ManifestResource
+        {
+            std::string name;
+            std::string path;
+            const Byte *data;
+            size_t size;
+            bool isPublic;
+        };
+        std::vector<ManifestResource> manifestResources_;
         std::string assemblyName_;
         std::string fileName_;
     	std::map<std::string, std::string> unmanagedRoutines_;
         int corFlags_;
+        bool deterministic_;
+        bool pe32Plus_;
+        bool compactStrings_;
+        bool hotReload_;
+        std::shared_ptr<PEBaseline> baseline_;
+        PEStatistics statistics_;
         std::vector<Namespace *> usingList_;
         CodeContainer *codeContainer_;
         const char *objInputBuf_;
@@ -26,27 +26,12 @@
 #include "PEWriter.h"
 #include <time.h>
 #include <stdio.h>
+#include <string.h>
 #ifdef QT_CORE_LIB
 #include <QtDebug>
 #endif
 namespace DotNetPELib
 {
-size_t IndexBase::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
-{
-    size_t rv;
-    DWord val = (index_ << GetIndexShift()) + tag_;
-    if (HasIndexOverflow(sizes))
-    {
-        *(DWord*)dest = val;
-        rv = 4;
-    }
-    else
-    {
-        *(Word*)dest = val;
-        rv = 2;
-    }
-    return rv;
-}
 size_t IndexBase::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
 {
     size_t val, rv;
@@ -132,48 +117,147 @@ bool String::HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const { re
 bool US::HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const { return Large(sizes[tUS]); }
 bool GUID::HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const { return Large(sizes[tGUID]); }
 bool Blob::HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const { return Large(sizes[tBlob]); }
-size_t ModuleTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+namespace
+{
+// the layout of a row of each table: fixed fields by their size in bytes and
+// index columns by the kind of index they hold
+enum
+{
+    Byte1 = MaxIndexKinds,
+    Byte2,
+    Byte4,
+    EndColumns
+};
+struct TableLayout
+{
+    int table;
+    int columns[10];
+};
+const TableLayout tableLayouts[] = {
+    { tModule, { Byte2, iString, iGUID, iGUID, iGUID, EndColumns } },
+    { tTypeRef, { iResolutionScope, iString, iString, EndColumns } },
+    { tTypeDef, { Byte4, iString, iString, iTypeDefOrRef, iFieldList, iMethodList, EndColumns } },
+    { tField, { Byte2, iString, iBlob, EndColumns } },
+    { tMethodDef, { Byte4, Byte2, Byte2, iString, iBlob, iParamList, EndColumns } },
+    { tParam, { Byte2, Byte2, iString, EndColumns } },
+    { tInterfaceImpl, { iTypeDef, iTypeDefOrRef, EndColumns } },
+    { tMemberRef, { iMemberRefParent, iString, iBlob, EndColumns } },
+    { tConstant, { Byte1, Byte1, iConstant, iBlob, EndColumns } },
+    { tCustomAttribute, { iCustomAttribute, iCustomAttributeType, iBlob, EndColumns } },
+    { tFieldMarshal, { iFieldMarshal, iBlob, EndColumns } },
+    { tDeclSecurity, { Byte2, iDeclSecurity, iBlob, EndColumns } },
+    { tClassLayout, { Byte2, Byte4, iTypeDef, EndColumns } },
+    { tFieldLayout, { Byte4, iFieldList, EndColumns } },
+    { tStandaloneSig, { iBlob, EndColumns } },
+    { tEventMap, { iTypeDef, iEventList, EndColumns } },
+    { tEvent, { Byte2, iString, iTypeDefOrRef, EndColumns } },
+    { tPropertyMap, { iTypeDef, iPropertyList, EndColumns } },
+    { tProperty, { Byte2, iString, iBlob, EndColumns } },
+    { tMethodSemantics, { Byte2, iMethodList, iSemantics, EndColumns } },
+    { tMethodImpl, { iTypeDef, iMethodDefOrRef, iMethodDefOrRef, EndColumns } },
+    { tModuleRef, { iString, EndColumns } },
+    { tTypeSpec, { iBlob, EndColumns } },
+    { tImplMap, { Byte2, iMemberForwarded, iString, iModuleRef, EndColumns } },
+    { tFieldRVA, { Byte4, iFieldList, EndColumns } },
+    { tEncLog, { Byte4, Byte4, EndColumns } },
+    { tEncMap, { Byte4, EndColumns } },
+    { tAssemblyDef, { Byte4, Byte2, Byte2, Byte2, Byte2, Byte4, iBlob, iString, iString, EndColumns } },
+    { tAssemblyRef, { Byte2, Byte2, Byte2, Byte2, Byte4, iBlob, iString, iString, iBlob, EndColumns } },
+    { tFile, { Byte4, iString, iBlob, EndColumns } },
+    { tExportedType, { Byte4, iTypeDef, iString, iString, iImplementation, EndColumns } },
+    { tManifestResource, { Byte4, Byte4, iString, iImplementation, EndColumns } },
+    { tNestedClass, { iTypeDef, iTypeDef, EndColumns } },
+    { tGenericParam, { Byte2, Byte2, iTypeOrMethodDef, iString, EndColumns } },
+    { tMethodSpec, { iMethodDefOrRef, iBlob, EndColumns } },
+    { tGenericParamConstraint, { iGenericRef, iTypeDefOrRef, EndColumns } },
+};
+// the overflow test of each kind of index, in the order of IndexKinds
+template <class Index> bool IndexOverflows(size_t sizes[MaxTables + ExtraIndexes]) { return Index().HasIndexOverflow(sizes); }
+bool (*const overflows[MaxIndexKinds])(size_t sizes[MaxTables + ExtraIndexes]) = {
+    IndexOverflows<ResolutionScope>,
+    IndexOverflows<TypeDefOrRef>,
+    IndexOverflows<TypeOrMethodDef>,
+    IndexOverflows<MethodDefOrRef>,
+    IndexOverflows<MemberRefParent>,
+    IndexOverflows<Constant>,
+    IndexOverflows<CustomAttribute>,
+    IndexOverflows<CustomAttributeType>,
+    IndexOverflows<MemberForwarded>,
+    IndexOverflows<EventList>,
+    IndexOverflows<FieldList>,
+    IndexOverflows<MethodList>,
+    IndexOverflows<ParamList>,
+    IndexOverflows<PropertyList>,
+    IndexOverflows<TypeDef>,
+    IndexOverflows<ModuleRef>,
+    IndexOverflows<DeclSecurity>,
+    IndexOverflows<Semantics>,
+    IndexOverflows<FieldMarshal>,
+    IndexOverflows<GenericRef>,
+    IndexOverflows<Implementation>,
+    IndexOverflows<String>,
+    IndexOverflows<US>,
+    IndexOverflows<GUID>,
+    IndexOverflows<Blob>,
+};
+}  // namespace
+
+bool MetaSchema::Overflows(int kind, size_t sizes[MaxTables + ExtraIndexes]) { return overflows[kind](sizes); }
+MetaSchema::MetaSchema(size_t sizes[MaxTables + ExtraIndexes])
 {
-    *(Word*)dest = 0;
-    size_t n = 2;
-    n += nameIndex_.Render(sizes, dest + n);
-    n += guidIndex_.Render(sizes, dest + n);
-    if (sizes[tGUID] > 65535)
-    {
-        *(DWord*)(dest + n) = 0;
-        n += 4;
-        *(DWord*)(dest + n) = 0;
-        n += 4;
-    }
-    else
+    for (int i = 0; i < MaxIndexKinds; i++)
+        large[i] = Overflows(i, sizes);
+
+    memset(rowSize, 0, sizeof(rowSize));
+    for (auto&& layout : tableLayouts)
     {
-        *(Word*)(dest + n) = 0;
-        n += 2;
-        *(Word*)(dest + n) = 0;
-        n += 2;
+        size_t n = 0;
+        for (const int* column = layout.columns; *column != EndColumns; column++)
+        {
+            switch (*column)
+            {
+                case Byte1:
+                    n += 1;
+                    break;
+                case Byte2:
+                    n += 2;
+                    break;
+                case Byte4:
+                    n += 4;
+                    break;
+                default:
+                    n += large[*column] ? 4 : 2;
+                    break;
+            }
+        }
+        rowSize[layout.table] = n;
     }
+}
+size_t ModuleTableEntry::Render(const MetaSchema& schema, Byte* dest) const
+{
+    *(Word*)dest = generation_;
+    size_t n = 2;
+    n += nameIndex_.Render(schema, dest + n);
+    n += guidIndex_.Render(schema, dest + n);
+    n += encIdIndex_.Render(schema, dest + n);
+    n += encBaseIdIndex_.Render(schema, dest + n);
     return n;
 }
 size_t ModuleTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
 {
+    generation_ = *(Word*)src;
     int n = 2;
     n += nameIndex_.Get(sizes, src + n);
     n += guidIndex_.Get(sizes, src + n);
-    if (sizes[tGUID] > 65535)
-    {
-        n += 8;
-    }
-    else
-    {
-        n += 4;
-    }
+    n += encIdIndex_.Get(sizes, src + n);
+    n += encBaseIdIndex_.Get(sizes, src + n);
     return n;
 }
-size_t TypeRefTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t TypeRefTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
-    int n = resolution_.Render(sizes, dest);
-    n += typeNameIndex_.Render(sizes, dest + n);
-    n += typeNameSpaceIndex_.Render(sizes, dest + n);
+    int n = resolution_.Render(schema, dest);
+    n += typeNameIndex_.Render(schema, dest + n);
+    n += typeNameSpaceIndex_.Render(schema, dest + n);
     return n;
 }
 size_t TypeRefTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -183,15 +267,15 @@ size_t TypeRefTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
     n += typeNameSpaceIndex_.Get(sizes, src + n);
     return n;
 }
-size_t TypeDefTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t TypeDefTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(DWord*)dest = flags_;
     int n = 4;
-    n += typeNameIndex_.Render(sizes, dest + n);
-    n += typeNameSpaceIndex_.Render(sizes, dest + n);
-    n += extends_.Render(sizes, dest + n);
-    n += fields_.Render(sizes, dest + n);
-    n += methods_.Render(sizes, dest + n);
+    n += typeNameIndex_.Render(schema, dest + n);
+    n += typeNameSpaceIndex_.Render(schema, dest + n);
+    n += extends_.Render(schema, dest + n);
+    n += fields_.Render(schema, dest + n);
+    n += methods_.Render(schema, dest + n);
     return n;
 }
 size_t TypeDefTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -205,12 +289,12 @@ size_t TypeDefTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
     n += methods_.Get(sizes, src + n);
     return n;
 }
-size_t FieldTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t FieldTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(Word*)dest = flags_;
     int n = 2;
-    n += nameIndex_.Render(sizes, dest + n);
-    n += signatureIndex_.Render(sizes, dest + n);
+    n += nameIndex_.Render(schema, dest + n);
+    n += signatureIndex_.Render(schema, dest + n);
     return n;
 }
 size_t FieldTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -221,7 +305,7 @@ size_t FieldTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
     n += signatureIndex_.Get(sizes, src + n);
     return n;
 }
-size_t MethodDefTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t MethodDefTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(DWord*)dest = method_->rva_;
     int n = 4;
@@ -229,9 +313,9 @@ size_t MethodDefTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte*
     n += 2;
     *(Word*)(dest + n) = flags_;
     n += 2;
-    n += nameIndex_.Render(sizes, dest + n);
-    n += signatureIndex_.Render(sizes, dest + n);
-    n += paramIndex_.Render(sizes, dest + n);
+    n += nameIndex_.Render(schema, dest + n);
+    n += signatureIndex_.Render(schema, dest + n);
+    n += paramIndex_.Render(schema, dest + n);
     return n;
 }
 size_t MethodDefTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -247,13 +331,13 @@ size_t MethodDefTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* sr
     n += paramIndex_.Get(sizes, src + n);
     return n;
 }
-size_t ParamTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t ParamTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(Word*)dest = flags_;
     int n = 2;
     *(Word*)(dest + n) = sequenceIndex_;
     n += 2;
-    n += nameIndex_.Render(sizes, dest + n);
+    n += nameIndex_.Render(schema, dest + n);
 
     return n;
 }
@@ -266,10 +350,10 @@ size_t ParamTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
     n += nameIndex_.Get(sizes, src + n);
     return n;
 }
-size_t InterfaceImplTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t InterfaceImplTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
-    int n = class_.Render(sizes, dest);
-    n += interface_.Render(sizes, dest + n);
+    int n = class_.Render(schema, dest);
+    n += interface_.Render(schema, dest + n);
     return n;
 }
 size_t InterfaceImplTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -278,11 +362,11 @@ size_t InterfaceImplTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte
     n += interface_.Get(sizes, src + n);
     return n;
 }
-size_t MemberRefTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t MemberRefTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
-    int n = parentIndex_.Render(sizes, dest);
-    n += nameIndex_.Render(sizes, dest + n);
-    n += signatureIndex_.Render(sizes, dest + n);
+    int n = parentIndex_.Render(schema, dest);
+    n += nameIndex_.Render(schema, dest + n);
+    n += signatureIndex_.Render(schema, dest + n);
     return n;
 }
 size_t MemberRefTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -292,13 +376,13 @@ size_t MemberRefTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* sr
     n += signatureIndex_.Get(sizes, src + n);
     return n;
 }
-size_t ConstantTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t ConstantTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(Byte*)dest = type_;
     *(Byte*)(dest + 1) = 0;
     int n = 2;
-    n += parentIndex_.Render(sizes, dest + n);
-    n += valueIndex_.Render(sizes, dest + n);
+    n += parentIndex_.Render(schema, dest + n);
+    n += valueIndex_.Render(schema, dest + n);
     return n;
 }
 size_t ConstantTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -309,11 +393,11 @@ size_t ConstantTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src
     n += valueIndex_.Get(sizes, src + n);
     return n;
 }
-size_t CustomAttributeTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t CustomAttributeTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
-    int n = parentIndex_.Render(sizes, dest);
-    n += typeIndex_.Render(sizes, dest + n);
-    n += valueIndex_.Render(sizes, dest + n);
+    int n = parentIndex_.Render(schema, dest);
+    n += typeIndex_.Render(schema, dest + n);
+    n += valueIndex_.Render(schema, dest + n);
     return n;
 }
 size_t CustomAttributeTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -323,10 +407,10 @@ size_t CustomAttributeTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], By
     n += valueIndex_.Get(sizes, src + n);
     return n;
 }
-size_t FieldMarshalTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t FieldMarshalTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
-    int n = parent_.Render(sizes, dest);
-    n += nativeType_.Render(sizes, dest + n);
+    int n = parent_.Render(schema, dest);
+    n += nativeType_.Render(schema, dest + n);
     return n;
 }
 size_t FieldMarshalTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -335,12 +419,12 @@ size_t FieldMarshalTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte*
     n += nativeType_.Get(sizes, src + n);
     return n;
 }
-size_t DeclSecurityTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t DeclSecurityTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(Word*)dest = action_;
     int n = 2;
-    n += parent_.Render(sizes, dest + n);
-    n += permissionSet_.Render(sizes, dest + n);
+    n += parent_.Render(schema, dest + n);
+    n += permissionSet_.Render(schema, dest + n);
     return n;
 }
 size_t DeclSecurityTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -351,13 +435,13 @@ size_t DeclSecurityTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte*
     n += permissionSet_.Get(sizes, src + n);
     return n;
 }
-size_t ClassLayoutTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t ClassLayoutTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(Word*)dest = pack_;
     int n = 2;
     *(DWord*)(dest + n) = size_;
     n += 4;
-    n += parent_.Render(sizes, dest + n);
+    n += parent_.Render(schema, dest + n);
     return n;
 }
 size_t ClassLayoutTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -369,11 +453,11 @@ size_t ClassLayoutTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte*
     n += parent_.Get(sizes, src + n);
     return n;
 }
-size_t FieldLayoutTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t FieldLayoutTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(DWord*)dest = offset_;
     int n = 4;
-    n += parent_.Render(sizes, dest + n);
+    n += parent_.Render(schema, dest + n);
     return n;
 }
 size_t FieldLayoutTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -383,15 +467,15 @@ size_t FieldLayoutTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte*
     n += parent_.Get(sizes, src + n);
     return n;
 }
-size_t StandaloneSigTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t StandaloneSigTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
-    return signatureIndex_.Render(sizes, dest);
+    return signatureIndex_.Render(schema, dest);
 }
 size_t StandaloneSigTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src) { return signatureIndex_.Get(sizes, src); }
-size_t EventMapTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t EventMapTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
-    int n = parent_.Render(sizes, dest);
-    n += eventList_.Render(sizes, dest + n);
+    int n = parent_.Render(schema, dest);
+    n += eventList_.Render(schema, dest + n);
     return n;
 }
 size_t EventMapTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -400,12 +484,12 @@ size_t EventMapTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src
     n += eventList_.Get(sizes, src + n);
     return n;
 }
-size_t EventTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t EventTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(Word*)dest = flags_;
     int n = 2;
-    n += name_.Render(sizes, dest + n);
-    n += eventType_.Render(sizes, dest + n);
+    n += name_.Render(schema, dest + n);
+    n += eventType_.Render(schema, dest + n);
     return n;
 }
 size_t EventTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -416,10 +500,10 @@ size_t EventTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
     n += eventType_.Get(sizes, src + n);
     return n;
 }
-size_t PropertyMapTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t PropertyMapTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
-    int n = parent_.Render(sizes, dest);
-    n += propertyList_.Render(sizes, dest + n);
+    int n = parent_.Render(schema, dest);
+    n += propertyList_.Render(schema, dest + n);
     return n;
 }
 size_t PropertyMapTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -428,12 +512,12 @@ size_t PropertyMapTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte*
     n += propertyList_.Get(sizes, src + n);
     return n;
 }
-size_t PropertyTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t PropertyTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(Word*)dest = flags_;
     int n = 2;
-    n += name_.Render(sizes, dest + n);
-    n += propertyType_.Render(sizes, dest + n);
+    n += name_.Render(schema, dest + n);
+    n += propertyType_.Render(schema, dest + n);
     return n;
 }
 size_t PropertyTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -444,12 +528,12 @@ size_t PropertyTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src
     n += propertyType_.Get(sizes, src + n);
     return n;
 }
-size_t MethodSemanticsTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t MethodSemanticsTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(Word*)dest = semantics_;
     int n = 2;
-    n += method_.Render(sizes, dest + n);
-    n += association_.Render(sizes, dest + n);
+    n += method_.Render(schema, dest + n);
+    n += association_.Render(schema, dest + n);
     return n;
 }
 size_t MethodSemanticsTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -460,11 +544,11 @@ size_t MethodSemanticsTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], By
     n += association_.Get(sizes, src + n);
     return n;
 }
-size_t MethodImplTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t MethodImplTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
-    int n = class_.Render(sizes, dest);
-    n += methodBody_.Render(sizes, dest + n);
-    n += methodDeclaration_.Render(sizes, dest + n);
+    int n = class_.Render(schema, dest);
+    n += methodBody_.Render(schema, dest + n);
+    n += methodDeclaration_.Render(schema, dest + n);
     return n;
 }
 size_t MethodImplTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -474,23 +558,23 @@ size_t MethodImplTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* s
     n += methodDeclaration_.Get(sizes, src + n);
     return n;
 }
-size_t ModuleRefTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t ModuleRefTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
-    return nameIndex_.Render(sizes, dest);
+    return nameIndex_.Render(schema, dest);
 }
 size_t ModuleRefTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src) { return nameIndex_.Get(sizes, src); }
-size_t TypeSpecTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t TypeSpecTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
-    return signatureIndex_.Render(sizes, dest);
+    return signatureIndex_.Render(schema, dest);
 }
 size_t TypeSpecTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src) { return signatureIndex_.Get(sizes, src); }
-size_t ImplMapTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t ImplMapTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(Word*)dest = flags_;
     int n = 2;
-    n += methodIndex_.Render(sizes, dest + n);
-    n += importNameIndex_.Render(sizes, dest + n);
-    n += moduleIndex_.Render(sizes, dest + n);
+    n += methodIndex_.Render(schema, dest + n);
+    n += importNameIndex_.Render(schema, dest + n);
+    n += moduleIndex_.Render(schema, dest + n);
     return n;
 }
 size_t ImplMapTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -502,12 +586,12 @@ size_t ImplMapTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
     n += moduleIndex_.Get(sizes, src + n);
     return n;
 }
-size_t FieldRVATableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t FieldRVATableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     // note that when reading rva_ holds the rva, when writing it holds an offset into the CIL section
     *(DWord*)dest = rva_ + PEWriter::cildata_rva_;
     int n = 4;
-    n += fieldIndex_.Render(sizes, dest + n);
+    n += fieldIndex_.Render(schema, dest + n);
     return n;
 }
 size_t FieldRVATableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -518,7 +602,29 @@ size_t FieldRVATableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src
     n += fieldIndex_.Get(sizes, src + n);
     return n;
 }
-size_t AssemblyDefTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t EncLogTableEntry::Render(const MetaSchema&, Byte* dest) const
+{
+    *(DWord*)dest = token_;
+    *(DWord*)(dest + 4) = funcCode_;
+    return 8;
+}
+size_t EncLogTableEntry::Get(size_t[MaxTables + ExtraIndexes], Byte* src)
+{
+    token_ = *(DWord*)src;
+    funcCode_ = *(DWord*)(src + 4);
+    return 8;
+}
+size_t EncMapTableEntry::Render(const MetaSchema&, Byte* dest) const
+{
+    *(DWord*)dest = token_;
+    return 4;
+}
+size_t EncMapTableEntry::Get(size_t[MaxTables + ExtraIndexes], Byte* src)
+{
+    token_ = *(DWord*)src;
+    return 4;
+}
+size_t AssemblyDefTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(DWord*)dest = DefaultHashAlgId;
     int n = 4;
@@ -533,9 +639,9 @@ size_t AssemblyDefTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byt
     n += 2;
     *(DWord*)(dest + n) = flags_;
     n += 4;
-    n += publicKeyIndex_.Render(sizes, dest + n);
-    n += nameIndex_.Render(sizes, dest + n);
-    n += cultureIndex_.Render(sizes, dest + n);
+    n += publicKeyIndex_.Render(schema, dest + n);
+    n += nameIndex_.Render(schema, dest + n);
+    n += cultureIndex_.Render(schema, dest + n);
     return n;
 }
 size_t AssemblyDefTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -558,7 +664,7 @@ size_t AssemblyDefTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte*
     n += cultureIndex_.Get(sizes, src + n);
     return n;
 }
-size_t AssemblyRefTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t AssemblyRefTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     int n = 0;
     // assembly version
@@ -572,10 +678,10 @@ size_t AssemblyRefTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byt
     n += 2;
     *(DWord*)(dest + n) = flags_;
     n += 4;
-    n += publicKeyIndex_.Render(sizes, dest + n);
-    n += nameIndex_.Render(sizes, dest + n);
-    n += cultureIndex_.Render(sizes, dest + n);
-    n += hashIndex_.Render(sizes, dest + n);
+    n += publicKeyIndex_.Render(schema, dest + n);
+    n += nameIndex_.Render(schema, dest + n);
+    n += cultureIndex_.Render(schema, dest + n);
+    n += hashIndex_.Render(schema, dest + n);
     return n;
 }
 size_t AssemblyRefTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -598,12 +704,12 @@ size_t AssemblyRefTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte*
     n += hashIndex_.Get(sizes, src + n);
     return n;
 }
-size_t FileTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t FileTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(DWord*)dest = flags_;
     int n = 4;
-    n += name_.Render(sizes, dest + n);
-    n += hash_.Render(sizes, dest + n);
+    n += name_.Render(schema, dest + n);
+    n += hash_.Render(schema, dest + n);
     return n;
 }
 size_t FileTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -614,14 +720,14 @@ size_t FileTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
     n += hash_.Get(sizes, src + n);
     return n;
 }
-size_t ExportedTypeTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t ExportedTypeTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(DWord*)(dest) = flags_;
     int n = 4;
-    n += typeDefId_.Render(sizes, dest + n);
-    n += typeName_.Render(sizes, dest + n);
-    n += typeNameSpace_.Render(sizes, dest + n);
-    n += implementation_.Render(sizes, dest + n);
+    n += typeDefId_.Render(schema, dest + n);
+    n += typeName_.Render(schema, dest + n);
+    n += typeNameSpace_.Render(schema, dest + n);
+    n += implementation_.Render(schema, dest + n);
     return n;
 }
 size_t ExportedTypeTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -634,13 +740,13 @@ size_t ExportedTypeTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte*
     n += implementation_.Get(sizes, src + n);
     return n;
 }
-size_t ManifestResourceTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t ManifestResourceTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(DWord*)dest = offset_;
     *(DWord*)(dest + 4) = flags_;
     int n = 8;
-    n += name_.Render(sizes, dest + n);
-    n += implementation_.Render(sizes, dest + n);
+    n += name_.Render(schema, dest + n);
+    n += implementation_.Render(schema, dest + n);
     return n;
 }
 size_t ManifestResourceTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -652,10 +758,10 @@ size_t ManifestResourceTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], B
     n += implementation_.Get(sizes, src + n);
     return n;
 }
-size_t NestedClassTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t NestedClassTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
-    int n = nestedIndex_.Render(sizes, dest);
-    n += enclosingIndex_.Render(sizes, dest + n);
+    int n = nestedIndex_.Render(schema, dest);
+    n += enclosingIndex_.Render(schema, dest + n);
     return n;
 }
 size_t NestedClassTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -664,13 +770,13 @@ size_t NestedClassTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte*
     n += enclosingIndex_.Get(sizes, src + n);
     return n;
 }
-size_t GenericParamTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t GenericParamTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
     *(Word*)dest = number_;
     *(Word*)(dest + 2) = flags_;
     int n = 4;
-    n += owner_.Render(sizes, dest + n);
-    n += name_.Render(sizes, dest + n);
+    n += owner_.Render(schema, dest + n);
+    n += name_.Render(schema, dest + n);
     return n;
 }
 size_t GenericParamTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -682,10 +788,10 @@ size_t GenericParamTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte*
     n += name_.Get(sizes, src + n);
     return n;
 }
-size_t MethodSpecTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t MethodSpecTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
-    int n = method_.Render(sizes, dest);
-    n += instantiation_.Render(sizes, dest + n);
+    int n = method_.Render(schema, dest);
+    n += instantiation_.Render(schema, dest + n);
     return n;
 }
 size_t MethodSpecTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -694,10 +800,10 @@ size_t MethodSpecTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* s
     n += instantiation_.Get(sizes, src + n);
     return n;
 }
-size_t GenericParamConstraintsTableEntry::Render(size_t sizes[MaxTables + ExtraIndexes], Byte* dest) const
+size_t GenericParamConstraintsTableEntry::Render(const MetaSchema& schema, Byte* dest) const
 {
-    int n = owner_.Render(sizes, dest);
-    n += constraint_.Render(sizes, dest + n);
+    int n = owner_.Render(schema, dest);
+    n += constraint_.Render(schema, dest + n);
     return n;
 }
 size_t GenericParamConstraintsTableEntry::Get(size_t sizes[MaxTables + ExtraIndexes], Byte* src)
@@ -26,6 +26,7 @@
 #ifndef _PEFILE_HEADER_
 #define _PEFILE_HEADER_
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <set>
@@ -117,6 +118,8 @@ namespace DotNetPELib {
         tTypeSpec = 27,// we use it for referenced types not found in the typedef table
         tImplMap = 28,// pinvoke DLL information
         tFieldRVA = 29,// cildata RVAs for field initialized data
+        tEncLog = 30,// the edits an edit-and-continue delta makes, only in deltas
+        tEncMap = 31,// the tokens of the rows in a delta
         tAssemblyDef = 32,// our main assembly
         tAssemblyRef = 35,// any external assemblies
         tFile = 38,
@@ -261,6 +264,50 @@ namespace DotNetPELib {
 
     };
 
+    // the kinds of index a table column can hold, one per index class below
+    enum IndexKinds
+    {
+        iResolutionScope,
+        iTypeDefOrRef,
+        iTypeOrMethodDef,
+        iMethodDefOrRef,
+        iMemberRefParent,
+        iConstant,
+        iCustomAttribute,
+        iCustomAttributeType,
+        iMemberForwarded,
+        iEventList,
+        iFieldList,
+        iMethodList,
+        iParamList,
+        iPropertyList,
+        iTypeDef,
+        iModuleRef,
+        iDeclSecurity,
+        iSemantics,
+        iFieldMarshal,
+        iGenericRef,
+        iImplementation,
+        iString,
+        iUS,
+        iGUID,
+        iBlob,
+        MaxIndexKinds
+    };
+
+    // the column widths used for one rendering of the tables: which kinds of
+    // index need four bytes and how long a row of each table is.  They are
+    // computed once from the final table counts and heap sizes
+    class MetaSchema
+    {
+    public:
+        MetaSchema(size_t sizes[MaxTables + ExtraIndexes]);
+        // whether sizes make columns of the kind of index take four bytes
+        static bool Overflows(int kind, size_t sizes[MaxTables + ExtraIndexes]);
+        bool large[MaxIndexKinds];
+        size_t rowSize[MaxTables];
+    };
+
     class MetaBase
     {
     public:
@@ -283,8 +330,22 @@ namespace DotNetPELib {
         IndexBase(size_t Index) : tag_(0), index_(Index) { }
         IndexBase(int Tag, size_t Index) : tag_(Tag), index_(Index) { }
 
-        size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const;
+        // each index class renders itself through this with its own shift and
+        // the width the schema chose for its kind
+        size_t Put(bool large, int shift, Byte *dest) const
+        {
+            DWord val = (index_ << shift) + tag_;
+            if (large)
+            {
+                *(DWord*)dest = val;
+                return 4;
+            }
+            *(Word*)dest = val;
+            return 2;
+        }
         size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *);
+        // the value as stored in the table, which is what sorted tables are ordered by
+        DWord Coded() const { return (index_ << GetIndexShift()) + tag_; }
         virtual int GetIndexShift() const = 0;
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const = 0;
 
@@ -311,6 +372,7 @@ namespace DotNetPELib {
         };
         virtual int GetIndexShift() const override { return TagBits; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iResolutionScope], TagBits, dest); }
     };
     class TypeDefOrRef : public IndexBase
     {
@@ -326,6 +388,7 @@ namespace DotNetPELib {
         };
         virtual int GetIndexShift() const override { return TagBits; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iTypeDefOrRef], TagBits, dest); }
     };
     class TypeOrMethodDef : public IndexBase
     {
@@ -340,6 +403,7 @@ namespace DotNetPELib {
         };
         virtual int GetIndexShift() const override { return TagBits; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iTypeOrMethodDef], TagBits, dest); }
     };
     class MethodDefOrRef : public IndexBase
     {
@@ -354,6 +418,7 @@ namespace DotNetPELib {
         };
         virtual int GetIndexShift() const override { return TagBits; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iMethodDefOrRef], TagBits, dest); }
     };
     class MemberRefParent : public IndexBase
     {
@@ -372,6 +437,7 @@ namespace DotNetPELib {
         };
         virtual int GetIndexShift() const override { return TagBits; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iMemberRefParent], TagBits, dest); }
     };
     class Constant : public IndexBase
     {
@@ -387,6 +453,7 @@ namespace DotNetPELib {
         };
         virtual int GetIndexShift() const override { return TagBits; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iConstant], TagBits, dest); }
     };
     class CustomAttribute : public IndexBase
     {
@@ -414,9 +481,18 @@ namespace DotNetPELib {
             File = 16,
             ExportedType = 17,
             ManifestResource = 18,
+            GenericParam = 19,
+            GenericParamConstraint = 20,
         };
+        void RemapRows(int table, const size_t *remap)
+        {
+            if ((table == tInterfaceImpl && tag_ == InterfaceImpl) || (table == tGenericParam && tag_ == GenericParam) ||
+                (table == tGenericParamConstraint && tag_ == GenericParamConstraint))
+                index_ = remap[index_];
+        }
         virtual int GetIndexShift() const override { return TagBits; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iCustomAttribute], TagBits, dest); }
     };
     class CustomAttributeType : public IndexBase
     {
@@ -432,6 +508,7 @@ namespace DotNetPELib {
         };
         virtual int GetIndexShift() const override { return TagBits; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iCustomAttributeType], TagBits, dest); }
     };
     class MemberForwarded : public IndexBase
     {
@@ -445,6 +522,7 @@ namespace DotNetPELib {
         };
         virtual int GetIndexShift() const override { return TagBits; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iMemberForwarded], TagBits, dest); }
     };
     class EventList : public IndexBase
     {
@@ -453,6 +531,7 @@ namespace DotNetPELib {
         EventList(int index) : IndexBase(index) { }
         virtual int GetIndexShift() const override { return 0; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iEventList], 0, dest); }
     };
     class FieldList : public IndexBase
     {
@@ -461,6 +540,7 @@ namespace DotNetPELib {
         FieldList(int index) : IndexBase(index) { }
         virtual int GetIndexShift() const override { return 0; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iFieldList], 0, dest); }
     };
     class MethodList : public IndexBase
     {
@@ -469,6 +549,7 @@ namespace DotNetPELib {
         MethodList(int index) : IndexBase(index) { }
         virtual int GetIndexShift() const override { return 0; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iMethodList], 0, dest); }
     };
     class ParamList : public IndexBase
     {
@@ -477,6 +558,7 @@ namespace DotNetPELib {
         ParamList(int index) : IndexBase(index) { }
         virtual int GetIndexShift() const override { return 0; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iParamList], 0, dest); }
     };
     class PropertyList : public IndexBase
     {
@@ -485,6 +567,7 @@ namespace DotNetPELib {
         PropertyList(int index) : IndexBase(index) { }
         virtual int GetIndexShift() const override { return 0; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iPropertyList], 0, dest); }
     };
     class TypeDef : public IndexBase
     {
@@ -493,6 +576,7 @@ namespace DotNetPELib {
         TypeDef(int index) : IndexBase(index) { }
         virtual int GetIndexShift() const override { return 0; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iTypeDef], 0, dest); }
     };
     class ModuleRef : public IndexBase
     {
@@ -501,6 +585,7 @@ namespace DotNetPELib {
         ModuleRef(int index) : IndexBase(index) { }
         virtual int GetIndexShift() const override { return 0; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iModuleRef], 0, dest); }
     };
     class DeclSecurity : public IndexBase
     {
@@ -515,6 +600,7 @@ namespace DotNetPELib {
         };
         virtual int GetIndexShift() const override { return TagBits; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iDeclSecurity], TagBits, dest); }
     };
     class Semantics : public IndexBase
     {
@@ -528,9 +614,11 @@ namespace DotNetPELib {
         };
         virtual int GetIndexShift() const override { return TagBits; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iSemantics], TagBits, dest); }
     };
     class FieldMarshal : public IndexBase
     {
+    public:
         enum Tags {
             TagBits = 1,
             Field = 0,
@@ -538,6 +626,7 @@ namespace DotNetPELib {
         };
         virtual int GetIndexShift() const override { return TagBits; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iFieldMarshal], TagBits, dest); }
     };
     class GenericRef : public IndexBase
     {
@@ -546,6 +635,7 @@ namespace DotNetPELib {
         GenericRef(int index) : IndexBase(index) { }
         virtual int GetIndexShift() const override { return 0; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iGenericRef], 0, dest); }
     };
     class Implementation : public IndexBase
     {
@@ -559,17 +649,27 @@ namespace DotNetPELib {
         };
         virtual int GetIndexShift() const override { return TagBits; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iImplementation], TagBits, dest); }
     };
     // we also have psuedo-indexes for the various streams
     // these are like regular indexes except streams are unambiguous so we don't need to shift
     // and add a tag
+    // old #Strings offsets paired with the new ones, sorted by the old offset
+    typedef std::vector<std::pair<size_t, size_t> > StringRemap;
     class String : public IndexBase
     {
     public:
         String() { }
         String(int index) : IndexBase(index) { }
+        void Remap(const StringRemap &remap)
+        {
+            auto it = std::lower_bound(remap.begin(), remap.end(), std::make_pair(index_, (size_t)0));
+            if (it != remap.end() && it->first == index_)
+                index_ = it->second;
+        }
         virtual int GetIndexShift() const override { return 0; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iString], 0, dest); }
     };
     class US : public IndexBase
     {
@@ -578,6 +678,7 @@ namespace DotNetPELib {
         US(int index) : IndexBase(index) { }
         virtual int GetIndexShift() const override { return 0; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iUS], 0, dest); }
     };
     class GUID : public IndexBase
     {
@@ -586,6 +687,7 @@ namespace DotNetPELib {
         GUID(int index) : IndexBase(index) { }
         virtual int GetIndexShift() const override { return 0; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iGUID], 0, dest); }
     };
 
     class Blob : public IndexBase
@@ -595,6 +697,7 @@ namespace DotNetPELib {
         Blob(int index) : IndexBase(index) { }
         virtual int GetIndexShift() const override { return 0; }
         virtual bool HasIndexOverflow(size_t sizes[MaxTables + ExtraIndexes]) const override;
+        size_t Render(const MetaSchema &schema, Byte *dest) const { return Put(schema.large[iBlob], 0, dest); }
     };
     // this is the base class for the metadata tables
     //
@@ -603,20 +706,33 @@ namespace DotNetPELib {
     public:
         virtual ~TableEntryBase() { }
         virtual int TableIndex() const = 0;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const = 0;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const = 0;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) = 0;
+        // replace the #Strings offsets in the row by the ones they moved to
+        virtual void RemapStrings(const StringRemap &) { }
+        // the primary key of the row in the tables ECMA-335 requires sorted
+        virtual ulonglong SortKey() const { return 0; }
+        // replace indexes of rows of the given table after it was sorted, remap
+        // is indexed by the old row index
+        virtual void RemapRows(int, const size_t *) { }
     };
 
     // following we have the data describing each table
     class ModuleTableEntry : public TableEntryBase
     {
     public:
-        ModuleTableEntry() { }
-        ModuleTableEntry(size_t NameIndex, size_t GuidIndex) : nameIndex_(NameIndex), guidIndex_(GuidIndex) { }
+        ModuleTableEntry() : generation_(0) { }
+        ModuleTableEntry(size_t NameIndex, size_t GuidIndex) : generation_(0), nameIndex_(NameIndex), guidIndex_(GuidIndex) { }
         virtual int TableIndex() const override { return tModule; }
+        // the number of deltas applied, and the guids which identify this
+        // generation and the one the delta applies to
+        Word generation_;
         String nameIndex_;
+        virtual void RemapStrings(const StringRemap &remap) override { nameIndex_.Remap(remap); }
         GUID guidIndex_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        GUID encIdIndex_;
+        GUID encBaseIdIndex_;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class TypeRefTableEntry : public TableEntryBase
@@ -629,7 +745,8 @@ namespace DotNetPELib {
         ResolutionScope resolution_;
         String typeNameIndex_;
         String typeNameSpaceIndex_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual void RemapStrings(const StringRemap &remap) override { typeNameIndex_.Remap(remap); typeNameSpaceIndex_.Remap(remap); }
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class TypeDefTableEntry : public TableEntryBase
@@ -701,10 +818,11 @@ namespace DotNetPELib {
         int flags_;
         String typeNameIndex_;
         String typeNameSpaceIndex_;
+        virtual void RemapStrings(const StringRemap &remap) override { typeNameIndex_.Remap(remap); typeNameSpaceIndex_.Remap(remap); }
         TypeDefOrRef extends_;
         FieldList fields_;
         MethodList methods_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
 
@@ -746,8 +864,9 @@ namespace DotNetPELib {
         virtual int TableIndex() const override { return tField; }
         int flags_;
         String nameIndex_;
+        virtual void RemapStrings(const StringRemap &remap) override { nameIndex_.Remap(remap); }
         Blob signatureIndex_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class MethodDefTableEntry : public TableEntryBase
@@ -828,9 +947,10 @@ namespace DotNetPELib {
         int implFlags_;
         int flags_;
         String nameIndex_;
+        virtual void RemapStrings(const StringRemap &remap) override { nameIndex_.Remap(remap); }
         Blob signatureIndex_;
         ParamList paramIndex_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class ParamTableEntry : public TableEntryBase
@@ -859,7 +979,8 @@ namespace DotNetPELib {
         int flags_;
         Word sequenceIndex_;
         String nameIndex_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual void RemapStrings(const StringRemap &remap) override { nameIndex_.Remap(remap); }
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class InterfaceImplTableEntry : public TableEntryBase
@@ -870,9 +991,10 @@ namespace DotNetPELib {
         InterfaceImplTableEntry(size_t cls, TypeDefOrRef interfce) :
             class_(cls), interface_(interfce) { }
         virtual int TableIndex() const override { return tInterfaceImpl; }
+        virtual ulonglong SortKey() const override { return ((ulonglong)class_.index_ << 32) + interface_.Coded(); }
         TypeDef class_;
         TypeDefOrRef interface_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class MemberRefTableEntry : public TableEntryBase
@@ -884,8 +1006,9 @@ namespace DotNetPELib {
         virtual int TableIndex() const override { return tMemberRef; }
         MemberRefParent parentIndex_;
         String nameIndex_;
+        virtual void RemapStrings(const StringRemap &remap) override { nameIndex_.Remap(remap); }
         Blob signatureIndex_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class ConstantTableEntry : public TableEntryBase
@@ -895,10 +1018,11 @@ namespace DotNetPELib {
         ConstantTableEntry(int Type, Constant ParentIndex, size_t ValueIndex) :
             type_(Type), parentIndex_(ParentIndex), valueIndex_(ValueIndex) { }
         virtual int TableIndex() const override { return tConstant; }
+        virtual ulonglong SortKey() const override { return parentIndex_.Coded(); }
         Byte type_;
         Constant parentIndex_;
         Blob valueIndex_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class CustomAttributeTableEntry : public TableEntryBase
@@ -908,10 +1032,12 @@ namespace DotNetPELib {
         CustomAttributeTableEntry(CustomAttribute ParentIndex, CustomAttributeType TypeIndex, size_t ValueIndex)
             : parentIndex_(ParentIndex), typeIndex_(TypeIndex), valueIndex_(ValueIndex) { }
         virtual int TableIndex() const override { return tCustomAttribute; }
+        virtual ulonglong SortKey() const override { return parentIndex_.Coded(); }
+        virtual void RemapRows(int table, const size_t *remap) override { parentIndex_.RemapRows(table, remap); }
         CustomAttribute parentIndex_;
         CustomAttributeType typeIndex_;
         Blob valueIndex_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class FieldMarshalTableEntry : public TableEntryBase
@@ -922,9 +1048,10 @@ namespace DotNetPELib {
         FieldMarshalTableEntry(FieldMarshal parent, size_t nativeType) :
             parent_(parent), nativeType_(nativeType) { }
         virtual int TableIndex() const override { return tFieldMarshal; }
+        virtual ulonglong SortKey() const override { return parent_.Coded(); }
         FieldMarshal parent_;
         Blob nativeType_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class DeclSecurityTableEntry : public TableEntryBase
@@ -934,11 +1061,12 @@ namespace DotNetPELib {
         DeclSecurityTableEntry(Word action, DeclSecurity parent, size_t permissionSet) :
             action_(action), parent_(parent), permissionSet_(permissionSet) { }
         virtual int TableIndex() const override { return tDeclSecurity; }
+        virtual ulonglong SortKey() const override { return parent_.Coded(); }
 
         Word action_;
         DeclSecurity parent_;
         Blob permissionSet_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class ClassLayoutTableEntry : public TableEntryBase
@@ -948,10 +1076,11 @@ namespace DotNetPELib {
         ClassLayoutTableEntry(Word Pack, size_t Size, size_t Parent)
             : pack_(Pack), size_(Size), parent_(Parent) { }
         virtual int TableIndex() const override { return tClassLayout; }
+        virtual ulonglong SortKey() const override { return parent_.index_; }
         Word pack_;
         size_t size_;
         TypeDef parent_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class FieldLayoutTableEntry : public TableEntryBase
@@ -960,9 +1089,10 @@ namespace DotNetPELib {
         FieldLayoutTableEntry() : offset_(0) { }
         FieldLayoutTableEntry(size_t Offset, size_t Parent) : offset_(Offset), parent_(Parent) { }
         virtual int TableIndex() const override { return tFieldLayout; }
+        virtual ulonglong SortKey() const override { return parent_.index_; }
         size_t offset_;
         FieldList parent_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class StandaloneSigTableEntry : public TableEntryBase
@@ -972,7 +1102,7 @@ namespace DotNetPELib {
         StandaloneSigTableEntry(size_t SignatureIndex) : signatureIndex_(SignatureIndex) { }
         virtual int TableIndex() const override { return tStandaloneSig; }
         Blob signatureIndex_;   
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class EventMapTableEntry : public TableEntryBase
@@ -983,7 +1113,7 @@ namespace DotNetPELib {
         TypeDef parent_;
         EventList eventList_;
         virtual int TableIndex() const override { return tEventMap; }
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class EventTableEntry : public TableEntryBase
@@ -999,9 +1129,10 @@ namespace DotNetPELib {
                 flags_(flags), name_(name), eventType_(eventType) { }
         Word flags_;
         String name_;
+        virtual void RemapStrings(const StringRemap &remap) override { name_.Remap(remap); }
         TypeDefOrRef eventType_;
         virtual int TableIndex() const override { return tEvent; }
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class PropertyMapTableEntry : public TableEntryBase
@@ -1012,7 +1143,7 @@ namespace DotNetPELib {
         TypeDef parent_;
         PropertyList propertyList_;
         virtual int TableIndex() const override { return tPropertyMap; }
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class PropertyTableEntry : public TableEntryBase
@@ -1029,9 +1160,10 @@ namespace DotNetPELib {
                 flags_(flags), name_(name), propertyType_(propertyType) { }
         Word flags_;
         String name_;
+        virtual void RemapStrings(const StringRemap &remap) override { name_.Remap(remap); }
         Blob propertyType_; // yes this is a signature in the Blob
         virtual int TableIndex() const override { return tProperty; }
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class MethodSemanticsTableEntry : public TableEntryBase
@@ -1053,7 +1185,8 @@ namespace DotNetPELib {
         MethodList method_;
         Semantics association_;
         virtual int TableIndex() const override { return tMethodSemantics; }
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual ulonglong SortKey() const override { return association_.Coded(); }
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class MethodImplTableEntry : public TableEntryBase
@@ -1066,7 +1199,8 @@ namespace DotNetPELib {
         MethodDefOrRef methodBody_;
         MethodDefOrRef methodDeclaration_;
         virtual int TableIndex() const override { return tMethodImpl; }
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual ulonglong SortKey() const override { return class_.index_; }
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class ModuleRefTableEntry : public TableEntryBase
@@ -1075,8 +1209,9 @@ namespace DotNetPELib {
         ModuleRefTableEntry() { }
         ModuleRefTableEntry(size_t NameIndex) : nameIndex_(NameIndex) { }
         String nameIndex_;
+        virtual void RemapStrings(const StringRemap &remap) override { nameIndex_.Remap(remap); }
         virtual int TableIndex() const override { return tModuleRef; }
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class TypeSpecTableEntry : public TableEntryBase
@@ -1086,7 +1221,7 @@ namespace DotNetPELib {
         TypeSpecTableEntry(size_t SignatureIndex) : signatureIndex_(SignatureIndex) { }
         virtual int TableIndex() const override { return tTypeSpec; }
         Blob signatureIndex_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
 
@@ -1133,12 +1268,14 @@ namespace DotNetPELib {
         ImplMapTableEntry(int Flags, MemberForwarded MethodIndex, size_t ImportNameIndex, size_t ModuleIndex)
             : flags_(Flags), methodIndex_(MethodIndex), importNameIndex_(ImportNameIndex), moduleIndex_(ModuleIndex) {  }
         virtual int TableIndex() const override { return tImplMap; }
+        virtual ulonglong SortKey() const override { return methodIndex_.Coded(); }
         // see Lidin p. 338
         int flags_;
         MemberForwarded methodIndex_;
         String importNameIndex_; // The name of the unmanaged method as it is defined in the export table of the unmanaged module
+        virtual void RemapStrings(const StringRemap &remap) override { importNameIndex_.Remap(remap); }
         ModuleRef moduleIndex_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class FieldRVATableEntry : public TableEntryBase
@@ -1147,9 +1284,42 @@ namespace DotNetPELib {
         FieldRVATableEntry() : rva_(0) { }
         FieldRVATableEntry(size_t Rva, size_t FieldIndex) : rva_(Rva), fieldIndex_(FieldIndex) { }
         virtual int TableIndex() const override { return tFieldRVA; }
+        virtual ulonglong SortKey() const override { return fieldIndex_.index_; }
         size_t rva_;
         FieldList fieldIndex_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
+        virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
+    };
+    // a row of an edit-and-continue delta, or the parent a member was added to
+    class EncLogTableEntry : public TableEntryBase
+    {
+    public:
+        enum FuncCodes
+        {
+            Default = 0,
+            AddMethod = 1,  // the token is the TypeDef of the method in the next entry
+            AddField = 2,   // the token is the TypeDef of the field in the next entry
+            AddParameter = 3,  // the token is the MethodDef of the param in the next entry
+            AddProperty = 4,  // the token is the PropertyMap of the property in the next entry
+            AddEvent = 5,  // the token is the EventMap of the event in the next entry
+        };
+        EncLogTableEntry() : token_(0), funcCode_(0) { }
+        EncLogTableEntry(DWord Token, DWord FuncCode) : token_(Token), funcCode_(FuncCode) { }
+        virtual int TableIndex() const override { return tEncLog; }
+        DWord token_;
+        DWord funcCode_;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
+        virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
+    };
+    // the token of each row a delta holds, in token order
+    class EncMapTableEntry : public TableEntryBase
+    {
+    public:
+        EncMapTableEntry() : token_(0) { }
+        EncMapTableEntry(DWord Token) : token_(Token) { }
+        virtual int TableIndex() const override { return tEncMap; }
+        DWord token_;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     enum AssemblyFlags
@@ -1192,7 +1362,8 @@ namespace DotNetPELib {
         Blob publicKeyIndex_;
         String nameIndex_;
         String cultureIndex_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual void RemapStrings(const StringRemap &remap) override { nameIndex_.Remap(remap); cultureIndex_.Remap(remap); }
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class AssemblyRefTableEntry : public TableEntryBase
@@ -1209,8 +1380,9 @@ namespace DotNetPELib {
         Blob publicKeyIndex_;
         String nameIndex_;
         String cultureIndex_;
+        virtual void RemapStrings(const StringRemap &remap) override { nameIndex_.Remap(remap); cultureIndex_.Remap(remap); }
         Blob hashIndex_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class FileTableEntry : public TableEntryBase
@@ -1225,9 +1397,10 @@ namespace DotNetPELib {
                 flags_(flags), name_(name), hash_(hash) { }
         DWord flags_;
         String name_;
+        virtual void RemapStrings(const StringRemap &remap) override { name_.Remap(remap); }
         Blob hash_;
         virtual int TableIndex() const override { return tFile; }
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class ExportedTypeTableEntry : public TableEntryBase
@@ -1241,9 +1414,10 @@ namespace DotNetPELib {
         TypeDef typeDefId_;
         String typeName_;
         String typeNameSpace_;
+        virtual void RemapStrings(const StringRemap &remap) override { typeName_.Remap(remap); typeNameSpace_.Remap(remap); }
         Implementation implementation_;
-        virtual int TableIndex() const override { return tManifestResource; }
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual int TableIndex() const override { return tExportedType; }
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class ManifestResourceTableEntry : public TableEntryBase
@@ -1260,9 +1434,10 @@ namespace DotNetPELib {
         DWord offset_;
         DWord flags_;
         String name_;
+        virtual void RemapStrings(const StringRemap &remap) override { name_.Remap(remap); }
         Implementation implementation_;
         virtual int TableIndex() const override { return tManifestResource; }
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class NestedClassTableEntry : public TableEntryBase
@@ -1271,9 +1446,10 @@ namespace DotNetPELib {
         NestedClassTableEntry() { }
         NestedClassTableEntry(size_t nested, size_t enclosing) : nestedIndex_(nested), enclosingIndex_(enclosing) { }
         virtual int TableIndex() const override { return tNestedClass; }
+        virtual ulonglong SortKey() const override { return nestedIndex_.index_; }
         TypeDef nestedIndex_;
         TypeDef enclosingIndex_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class GenericParamTableEntry : public TableEntryBase
@@ -1283,11 +1459,13 @@ namespace DotNetPELib {
         GenericParamTableEntry(Word number, Word flags, TypeOrMethodDef owner, size_t name)
                 : number_(number), flags_(flags), owner_(owner), name_(name) { }
         virtual int TableIndex() const override { return tGenericParam; }
+        virtual ulonglong SortKey() const override { return ((ulonglong)owner_.Coded() << 32) + number_; }
         Word number_;
         Word flags_;
         TypeOrMethodDef owner_;
         String name_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual void RemapStrings(const StringRemap &remap) override { name_.Remap(remap); }
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class MethodSpecTableEntry : public TableEntryBase
@@ -1299,7 +1477,7 @@ namespace DotNetPELib {
         virtual int TableIndex() const override { return tMethodSpec; }
         MethodDefOrRef method_;
         Blob instantiation_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
     class GenericParamConstraintsTableEntry : public TableEntryBase
@@ -1308,10 +1486,16 @@ namespace DotNetPELib {
         GenericParamConstraintsTableEntry() { }
         GenericParamConstraintsTableEntry(size_t owner, TypeDefOrRef constraint) : 
                 owner_(owner), constraint_(constraint) { }
-        virtual int TableIndex() const override { return tGenericParam; }
+        virtual int TableIndex() const override { return tGenericParamConstraint; }
+        virtual ulonglong SortKey() const override { return owner_.index_; }
+        virtual void RemapRows(int table, const size_t *remap) override
+        {
+            if (table == tGenericParam)
+                owner_.index_ = remap[owner_.index_];
+        }
         GenericRef owner_;
         TypeDefOrRef constraint_;
-        virtual size_t Render(size_t sizes[MaxTables + ExtraIndexes], Byte *) const override;
+        virtual size_t Render(const MetaSchema &schema, Byte *) const override;
         virtual size_t Get(size_t sizes[MaxTables + ExtraIndexes], Byte *) override;
     };
 
@@ -25,14 +25,23 @@
 
 #include "PEWriter.h"
 #include "PEWriter_Private.h"
+#include "PELib.h"
 #include "PELibError.h"
-#include "SignatureGenerator.h"
 #include "sha1.h"
 #include <time.h>
 #include <stdio.h>
 #include <string.h>
 #include <iostream>
+#include <fstream>
 #include <cassert>
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <stddef.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define PELIB_SSE2
+#endif
 #ifdef QT_CORE_LIB
 #include <QtDebug>
 #endif
@@ -63,12 +72,19 @@ Byte PEWriter::MZHeader_[] = { // MS-DOS header
     0x6d, 0x6f, 0x64, 0x65, 0x2e, 0x0d, 0x0d, 0x0a,
     0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 };
+
+// the image size per thread rendering it
+static const size_t parallelSize = 1024 * 1024;
+
 const char* PEWriter::streamNames_[5] = {"#~", "#Strings", "#US", "#GUID", "#Blob"};
 
 static DotNetMetaHeader metaHeader1 = {META_SIG, 1, 1, 0};
 DotNetMetaHeader* PEWriter::metaHeader_ = &metaHeader1;
 
 DWord PEWriter::cildata_rva_;
+const int PEWriter::sortedTables_[] = { tInterfaceImpl, tGenericParam, tGenericParamConstraint, tConstant, tFieldMarshal,
+                                        tDeclSecurity, tClassLayout, tFieldLayout, tMethodSemantics, tMethodImpl,
+                                        tImplMap, tFieldRVA, tNestedClass, tCustomAttribute };
 Byte PEWriter::defaultUS_[8] = {0, 3, 0x20, 0, 0};
 
 PEMethod::PEMethod(bool hasSEH, int Flags, size_t MethodDef, int MaxStack,
@@ -98,7 +114,7 @@ PEMethod::~PEMethod()
         delete[] code_;
 }
 
-size_t PEMethod::Write(size_t sizes[MaxTables + ExtraIndexes], std::iostream& out) const
+size_t PEMethod::Write(const size_t sizes[MaxTables + ExtraIndexes], Byte* out) const
 {
     Byte dest[512];
     int n;
@@ -115,17 +131,15 @@ size_t PEMethod::Write(size_t sizes[MaxTables + ExtraIndexes], std::iostream& ou
         *(DWord*)(dest + 4) = codeSize_;
         *(DWord*)(dest + 8) = signatureToken_;
     }
-    out.write((char*)dest, n);
+    memcpy(out, dest, n);
     assert( code_ != 0 );
-    out.write((char*)code_, codeSize_);
+    memcpy(out + n, code_, codeSize_);
     n += codeSize_;
     if (sehData_.size())
     {
         if (n % 4)
         {
-            char align[4];
-            memset(align, 0, sizeof(align));
-            out.write((char*)align, 4 - n % 4);
+            memset(out + n, 0, 4 - n % 4);
             n = n + 3;
             n = n & ~3;
         }
@@ -146,7 +160,7 @@ size_t PEMethod::Write(size_t sizes[MaxTables + ExtraIndexes], std::iostream& ou
             header[1] = sehData_.size() * 12 + 4;
             header[2] = 0;
             header[3] = 0;
-            out.write((char*)header, 4);
+            memcpy(out + n, header, 4);
             n += 4;
             for (int i = 0; i < sehData_.size(); i++)
             {
@@ -174,7 +188,7 @@ size_t PEMethod::Write(size_t sizes[MaxTables + ExtraIndexes], std::iostream& ou
                     bytes[10] = (data.classToken >> 16) & 0xff;
                     bytes[11] = (data.classToken >> 24) & 0xff;
                 }
-                out.write((char*)bytes, 12);
+                memcpy(out + n, bytes, 12);
                 n += 12;
             }
         }
@@ -186,7 +200,7 @@ size_t PEMethod::Write(size_t sizes[MaxTables + ExtraIndexes], std::iostream& ou
             header[1] = q & 0xff;
             header[2] = (q >> 8) & 0xff;
             header[3] = (q >> 16) & 0xff;
-            out.write((char*)header, 4);
+            memcpy(out + n, header, 4);
             n += 4;
             for (int i = 0; i < sehData_.size(); i++)
             {
@@ -226,7 +240,7 @@ size_t PEMethod::Write(size_t sizes[MaxTables + ExtraIndexes], std::iostream& ou
                     bytes[22] = (data.classToken >> 16) & 0xff;
                     bytes[23] = (data.classToken >> 24) & 0xff;
                 }
-                out.write((char*)bytes, 24);
+                memcpy(out + n, bytes, 24);
                 n += 24;
             }
         }
@@ -234,16 +248,90 @@ size_t PEMethod::Write(size_t sizes[MaxTables + ExtraIndexes], std::iostream& ou
     return n;
 }
 
+PEWriter::pool::~pool()
+{
+    for (auto&& segment : segments)
+        free(segment.base);
+}
 void PEWriter::pool::Ensure(size_t newSize)
 {
-    if (size + newSize > maxSize)
+    if (segments.empty() || segments.back().used + newSize > segments.back().capacity)
     {
-        if (size + newSize < maxSize * 2)
-            maxSize = maxSize * 2;
-        else
-            maxSize = (maxSize + newSize) * 2;
-        base = (Byte*)realloc(base, maxSize);
+        // double the segments up to a megabyte, past that the heap grows linearly
+        size_t capacity = segments.empty() ? 256 : std::min(segments.back().capacity * 2, (size_t)1 << 20);
+        segment segment = { (Byte*)calloc(1, std::max(capacity, newSize)), size, 0, std::max(capacity, newSize) };
+        segments.push_back(segment);
+    }
+}
+Byte* PEWriter::pool::At(size_t offset) const
+{
+    auto it = std::upper_bound(segments.begin(), segments.end(), offset,
+                               [](size_t offset, const segment& segment) { return offset < segment.start; });
+    --it;
+    return it->base + offset - it->start;
+}
+void PEWriter::pool::CopyTo(Byte* dest, size_t offset) const
+{
+    for (auto&& segment : segments)
+        if (segment.start + segment.used > offset)
+        {
+            size_t skip = offset > segment.start ? offset - segment.start : 0;
+            memcpy(dest + segment.start + skip - offset, segment.base + skip, segment.used - skip);
+        }
+}
+void PEWriter::pool::Continue(const pool& baseline)
+{
+    Ensure(baseline.size);
+    baseline.CopyTo(Tail());
+    Commit(baseline.size);
+    index = baseline.index;
+    used = baseline.used;
+}
+size_t PEWriter::pool::HashBytes(const Byte* data, size_t len)
+{
+    // FNV-1a
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash;
+}
+size_t PEWriter::pool::Intern(const Byte* data, size_t len, size_t hash)
+{
+    added++;
+    if ((used + 1) * 4 > index.size() * 3)
+    {
+        std::vector<slot> old;
+        old.swap(index);
+        index.resize(old.empty() ? 256 : old.size() * 2);
+        for (auto&& s : old)
+            if (s.len)
+            {
+                size_t i = s.hash & (index.size() - 1);
+                while (index[i].len)
+                    i = (i + 1) & (index.size() - 1);
+                index[i] = s;
+            }
+    }
+    size_t i = hash & (index.size() - 1);
+    while (index[i].len)
+    {
+        if (index[i].hash == hash && index[i].len == len && !memcmp(At(index[i].offset), data, len))
+        {
+            shared++;
+            return index[i].offset;
+        }
+        i = (i + 1) & (index.size() - 1);
     }
+    if (segments.empty() || data != Tail())
+    {
+        Ensure(len);
+        memcpy(Tail(), data, len);
+    }
+    slot s = { size, len, hash };
+    index[i] = s;
+    used++;
+    Commit(len);
+    return s.offset;
 }
 PEWriter::~PEWriter()
 {
@@ -251,35 +339,70 @@ PEWriter::~PEWriter()
     delete peObjects_;
     delete cor20Header_;
     delete tablesHeader_;
-    for (int i = 0; i < MaxTables; i++)
-    {
-        for (auto it = tables_[i].begin(); it != tables_[i].end(); it++)
-        {
-            TableEntryBase* x = *it;
-            delete x;
-        }
-    }
     for (auto it = methods_.begin(); it != methods_.end(); ++it)
     {
         PEMethod* method = *it;
         delete method;
     }
 }
-size_t PEWriter::AddTableEntry(TableEntryBase* entry)
+template <class Entry> size_t PEWriter::InternTableEntry(const Entry& entry)
 {
-    const int n = entry->TableIndex();
-    tables_[n].push_back(entry);
-#if 0
-    // seems to alway apply
-    if( n == tMethodDef )
-    {
-        MethodDefTableEntry* e = (MethodDefTableEntry*)entry;
-        const int id = tables_[n].size();
-        Q_ASSERT( id == e->method_->methodDef_ );
-    }
-#endif
-    return tables_[n].size();
+    RowKey key = Key(entry);
+    auto it = internedRows_.find(key);
+    if (it != internedRows_.end())
+        return it->second;
+    size_t index = AddTableEntry<Entry>(entry);
+    internedRows_.insert(std::make_pair(key, index));
+    return index;
+}
+PEWriter::RowKey PEWriter::Key(const TypeRefTableEntry& entry)
+{
+    RowKey key = { tTypeRef,
+                   { entry.resolution_.Coded(), entry.typeNameIndex_.index_, entry.typeNameSpaceIndex_.index_, 0 } };
+    return key;
+}
+PEWriter::RowKey PEWriter::Key(const MemberRefTableEntry& entry)
+{
+    RowKey key = { tMemberRef,
+                   { entry.parentIndex_.Coded(), entry.nameIndex_.index_, entry.signatureIndex_.index_, 0 } };
+    return key;
+}
+PEWriter::RowKey PEWriter::Key(const TypeSpecTableEntry& entry)
+{
+    RowKey key = { tTypeSpec, { entry.signatureIndex_.index_, 0, 0, 0 } };
+    return key;
+}
+PEWriter::RowKey PEWriter::Key(const StandaloneSigTableEntry& entry)
+{
+    RowKey key = { tStandaloneSig, { entry.signatureIndex_.index_, 0, 0, 0 } };
+    return key;
 }
+PEWriter::RowKey PEWriter::Key(const AssemblyRefTableEntry& entry)
+{
+    ulonglong version = ((ulonglong)entry.major_ << 48) + ((ulonglong)entry.minor_ << 32) +
+                        ((ulonglong)entry.build_ << 16) + entry.revision_;
+    RowKey key = { tAssemblyRef,
+                   { entry.nameIndex_.index_, entry.publicKeyIndex_.index_, version,
+                     ((ulonglong)(DWord)entry.flags_ << 32) + entry.cultureIndex_.index_ } };
+    return key;
+}
+PEWriter::RowKey PEWriter::Key(const ModuleRefTableEntry& entry)
+{
+    RowKey key = { tModuleRef, { entry.nameIndex_.index_, 0, 0, 0 } };
+    return key;
+}
+PEWriter::RowKey PEWriter::Key(const MethodSpecTableEntry& entry)
+{
+    RowKey key = { tMethodSpec, { entry.method_.Coded(), entry.instantiation_.index_, 0, 0 } };
+    return key;
+}
+size_t PEWriter::AddTableEntry(const TypeRefTableEntry& entry) { return InternTableEntry(entry); }
+size_t PEWriter::AddTableEntry(const MemberRefTableEntry& entry) { return InternTableEntry(entry); }
+size_t PEWriter::AddTableEntry(const TypeSpecTableEntry& entry) { return InternTableEntry(entry); }
+size_t PEWriter::AddTableEntry(const StandaloneSigTableEntry& entry) { return InternTableEntry(entry); }
+size_t PEWriter::AddTableEntry(const AssemblyRefTableEntry& entry) { return InternTableEntry(entry); }
+size_t PEWriter::AddTableEntry(const ModuleRefTableEntry& entry) { return InternTableEntry(entry); }
+size_t PEWriter::AddTableEntry(const MethodSpecTableEntry& entry) { return InternTableEntry(entry); }
 void PEWriter::AddMethod(PEMethod* method)
 {
     if (method->flags_ & PEMethod::EntryPoint)
@@ -290,107 +413,425 @@ void PEWriter::AddMethod(PEMethod* method)
     }
     methods_.push_back(method);
 }
-size_t PEWriter::HashString(const std::string& utf8)
+size_t PEWriter::StringHash(const std::string& utf8)
+{
+    // the terminating \0 is part of the heap entry
+    return pool::HashBytes((const Byte*)utf8.c_str(), utf8.size() + 1);
+}
+size_t PEWriter::HashString(const std::string& utf8) { return HashString(utf8, StringHash(utf8)); }
+size_t PEWriter::HashString(const std::string& utf8, size_t hash)
 {
-    auto it = stringMap_.find(utf8);
-    if (it != stringMap_.end())
-        return it->second;
     if (strings_.size == 0)
-        strings_.size++;
-    strings_.Ensure(utf8.size() + 1);
-    size_t rv = strings_.size;
-    memcpy(strings_.base + strings_.size, utf8.c_str(), utf8.size() + 1);
-    strings_.size += utf8.size() + 1;
-    stringMap_[utf8] = rv;
-    return rv;
+    {
+        strings_.Ensure(1);
+        strings_.Commit(1);
+    }
+    return strings_.Intern((const Byte*)utf8.c_str(), utf8.size() + 1, hash);
 }
-size_t PEWriter::HashUS(wchar_t* str, int len)
+void PEWriter::MergeStringSuffixes()
 {
-    if (us_.size == 0)
-        us_.size++;
-    int flag = 0;
-    us_.Ensure(len * 2 + 5);
-    size_t rv = us_.size;
-    int blobLen = len * 2 + 1;
-    if (blobLen < 0x80)
+    // sort the names by their reversed text, so that a name which is the tail of
+    // other names comes right before all of them
+    struct name
+    {
+        pool::slot* slot;
+        const Byte* text;
+    };
+    std::vector<name> names;
+    for (auto&& slot : strings_.index)
+        if (slot.len)
+        {
+            name n = { &slot, strings_.At(slot.offset) };
+            names.push_back(n);
+        }
+    std::sort(names.begin(), names.end(), [](const name& left, const name& right) {
+        const Byte* l = left.text + left.slot->len - 1;
+        const Byte* r = right.text + right.slot->len - 1;
+        size_t n = std::min(left.slot->len, right.slot->len) - 1;
+        while (n--)
+            if (*--l != *--r)
+                return *l < *r;
+        return left.slot->len < right.slot->len;
+    });
+    // walking backwards each name either lies at the end of its successor, or of
+    // the name that one went into, or keeps its own bytes
+    std::vector<size_t> host(names.size()), tail(names.size());
+    for (size_t i = names.size(); i--;)
     {
-        us_.base[us_.size++] = blobLen;
+        host[i] = i;
+        tail[i] = 0;
+        if (i + 1 < names.size())
+        {
+            size_t len = names[i].slot->len, nextLen = names[i + 1].slot->len;
+            if (len <= nextLen && !memcmp(names[i].text, names[i + 1].text + nextLen - len, len))
+            {
+                host[i] = host[i + 1];
+                tail[i] = tail[i + 1] + nextLen - len;
+            }
+        }
     }
-    else if (blobLen <= 0x3fff)
+    // lay out the remaining names in their original order
+    std::vector<size_t> kept;
+    for (size_t i = 0; i < names.size(); i++)
+        if (host[i] == i)
+            kept.push_back(i);
+    std::sort(kept.begin(), kept.end(), [&names](size_t left, size_t right) {
+        return names[left].slot->offset < names[right].slot->offset;
+    });
+    std::vector<size_t> newOffset(names.size());
+    pool compacted;
+    compacted.Ensure(1);
+    compacted.Commit(1);
+    for (auto i : kept)
     {
-        us_.base[us_.size++] = (blobLen >> 8) | 0x80;
-        us_.base[us_.size++] = blobLen;
+        size_t len = names[i].slot->len;
+        compacted.Ensure(len);
+        memcpy(compacted.Tail(), names[i].text, len);
+        newOffset[i] = compacted.size;
+        compacted.Commit(len);
+    }
+    // one pair per name rather than an entry per byte of the heap
+    StringRemap remap;
+    remap.reserve(names.size());
+    for (size_t i = 0; i < names.size(); i++)
+        remap.push_back(std::make_pair(names[i].slot->offset, newOffset[host[i]] + tail[i]));
+    std::sort(remap.begin(), remap.end());
+    for (size_t i = 0; i < names.size(); i++)
+        names[i].slot->offset = newOffset[host[i]] + tail[i];
+    strings_.segments.swap(compacted.segments);
+    strings_.size = compacted.size;
+    for (auto&& table : tables_)
+        for (auto entry : table)
+            entry->RemapStrings(remap);
+}
+void PEWriter::SortTables()
+{
+    // the tables ECMA-335 wants sorted by their primary key, the runtime looks
+    // rows up in them by binary search. Rows are added in the order the code is
+    // dumped, so they are usually in order already. The tables other rows refer
+    // to come first, so the references are final when those rows are sorted
+    auto less = [](const TableEntryBase* left, const TableEntryBase* right) {
+        return left->SortKey() < right->SortKey();
+    };
+    for (int n : sortedTables_)
+    {
+        DNLTable& table = tables_[n];
+        if (std::is_sorted(table.begin(), table.end(), less))
+            continue;
+        std::vector<size_t> order(table.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(),
+                         [&table, &less](size_t left, size_t right) { return less(table[left], table[right]); });
+        rows_[n]->Reorder(order, table);
+        if (n == tInterfaceImpl || n == tGenericParam || n == tGenericParamConstraint)
+        {
+            std::vector<size_t> remap(order.size() + 1, 0);
+            for (size_t i = 0; i < order.size(); i++)
+                remap[order[i] + 1] = i + 1;
+            for (auto&& other : tables_)
+                for (auto entry : other)
+                    entry->RemapRows(n, &remap[0]);
+        }
+    }
+}
+// the names ECMA-335 gives the tables and the heaps
+static const char* const tableNames[MaxTables + ExtraIndexes] = {
+    "Module", "TypeRef", "TypeDef", "FieldPtr", "Field", "MethodPtr", "MethodDef", "ParamPtr", "Param",
+    "InterfaceImpl", "MemberRef", "Constant", "CustomAttribute", "FieldMarshal", "DeclSecurity", "ClassLayout",
+    "FieldLayout", "StandAloneSig", "EventMap", "EventPtr", "Event", "PropertyMap", "PropertyPtr", "Property",
+    "MethodSemantics", "MethodImpl", "ModuleRef", "TypeSpec", "ImplMap", "FieldRVA", "EncLog", "EncMap",
+    "Assembly", "AssemblyProcessor", "AssemblyOS", "AssemblyRef", "AssemblyRefProcessor", "AssemblyRefOS", "File",
+    "ExportedType", "ManifestResource", "NestedClass", "GenericParam", "MethodSpec", "GenericParamConstraint",
+    nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+    nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "#Strings", "#US", "#GUID", "#Blob"
+};
+void PEWriter::GetStatistics(PEStatistics& statistics) const
+{
+    static const char* const indexNames[MaxIndexKinds] = {
+        "ResolutionScope", "TypeDefOrRef", "TypeOrMethodDef", "MethodDefOrRef", "MemberRefParent", "HasConstant",
+        "HasCustomAttribute", "CustomAttributeType", "MemberForwarded", "Event", "Field", "MethodDef", "Param",
+        "Property", "TypeDef", "ModuleRef", "HasDeclSecurity", "HasSemantics", "HasFieldMarshal", "GenericParam",
+        "Implementation", "#Strings", "#US", "#GUID", "#Blob"
+    };
+    size_t counts[MaxTables + ExtraIndexes];
+    memset(counts, 0, sizeof(counts));
+    for (int i = 0; i < MaxTables; i++)
+        counts[i] = tables_[i].size();
+    counts[tString] = strings_.size;
+    counts[tUS] = us_.size;
+    counts[tGUID] = guid_.size;
+    counts[tBlob] = blob_.size;
+    MetaSchema schema(counts);
+
+    statistics = PEStatistics();
+    for (int i = 0; i < MaxTables; i++)
+        if (counts[i])
+        {
+            PEStatistics::Table table = { i, tableNames[i], counts[i], counts[i] * schema.rowSize[i] };
+            statistics.tables.push_back(table);
+        }
+    const pool* heaps[] = { &strings_, &us_, &guid_, &blob_ };
+    for (int i = 0; i < 4; i++)
+    {
+        PEStatistics::Heap heap = { tableNames[tString + i], heaps[i]->size, heaps[i]->size >= 65536, heaps[i]->added,
+                                    heaps[i]->shared };
+        statistics.heaps.push_back(heap);
+    }
+    // a column is wide as soon as one of the tables it can refer to is too large,
+    // so the culprit is the largest table that is too large on its own
+    for (int i = 0; i < MaxIndexKinds; i++)
+    {
+        PEStatistics::Index index = { indexNames[i], schema.large[i], nullptr };
+        if (index.wide)
+        {
+            size_t alone[MaxTables + ExtraIndexes], largest = 0;
+            memset(alone, 0, sizeof(alone));
+            for (int j = 0; j < MaxTables + ExtraIndexes; j++)
+            {
+                alone[j] = counts[j];
+                if (counts[j] > largest && MetaSchema::Overflows(i, alone))
+                {
+                    largest = counts[j];
+                    index.trigger = tableNames[j];
+                }
+                alone[j] = 0;
+            }
+        }
+        statistics.indexes.push_back(index);
+    }
+    // a body runs up to the next one, the last one up to the end of the bodies
+    std::vector<const PEMethod*> bodies;
+    for (auto method : methods_)
+        if (method->flags_ & PEMethod::CIL)
+            bodies.push_back(method);
+    for (size_t i = 0; i < bodies.size(); i++)
+    {
+        size_t end = i + 1 < bodies.size() ? bodies[i + 1]->rva_ : methodsEnd_;
+        if ((bodies[i]->flags_ & 3) == PEMethod::TinyFormat)
+        {
+            statistics.tinyMethods++;
+            statistics.tinyBytes += end - bodies[i]->rva_;
+        }
+        else
+        {
+            statistics.fatMethods++;
+            statistics.fatBytes += end - bodies[i]->rva_;
+        }
+    }
+}
+// ECMA-335 compressed unsigned integer, as used for the length of heap entries
+static Byte* PutLength(Byte* p, size_t len)
+{
+    if (len < 0x80)
+    {
+        *p++ = len;
+    }
+    else if (len <= 0x3fff)
+    {
+        *p++ = (len >> 8) | 0x80;
+        *p++ = len;
     }
     else
     {
-        blobLen &= 0x1fffffff;
-        us_.base[us_.size++] = (blobLen >> 24) | 0xc0;
-        us_.base[us_.size++] = (blobLen >> 16);
-        us_.base[us_.size++] = (blobLen >> 8);
-        us_.base[us_.size++] = (blobLen >> 0);
+        len &= 0x1fffffff;
+        *p++ = (len >> 24) | 0xc0;
+        *p++ = (len >> 16);
+        *p++ = (len >> 8);
+        *p++ = (len >> 0);
     }
+    return p;
+}
+static size_t LengthSize(size_t len) { return len < 0x80 ? 1 : len <= 0x3fff ? 2 : 4; }
+// the characters which make the trailing byte of a #US entry 1
+static inline bool SpecialUS(unsigned n)
+{
+    return (n & 0xff00) || n <= 8 || (n >= 0x0e && n < 0x20) || n == 0x27 || n == 0x2d || n == 0x7f;
+}
+template <class Char> size_t PEWriter::HashUS(const Char* str, int len)
+{
+    if (us_.size == 0)
+    {
+        us_.Ensure(1);
+        us_.Commit(1);
+    }
+    int flag = 0;
+    us_.Ensure(len * 2 + 5);
+    // stage the string past the end of the heap and let Intern decide whether to keep it
+    Byte* p = PutLength(us_.Tail(), len * 2 + 1);
     for (int i = 0; i < len; i++)
     {
         int n = str[i];
-        if (n & 0xff00)
+        if (SpecialUS(n & 0xffff))
             flag = 1;
-        else if (n <= 8 || (n >= 0x0e && n < 0x20) || n == 0x27 || n == 0x2d || n == 0x7f)
+        *p++ = n & 0xff;
+        *p++ = n >> 8;
+    }
+    *p++ = flag;
+    return us_.Intern(p - us_.Tail());
+}
+size_t PEWriter::HashUS(const wchar_t* str, int len) { return HashUS<wchar_t>(str, len); }
+size_t PEWriter::HashUS(const Word* str, int len) { return HashUS<Word>(str, len); }
+size_t PEWriter::HashUS(const char* utf8, int len)
+{
+    if (us_.size == 0)
+    {
+        us_.Ensure(1);
+        us_.Commit(1);
+    }
+    // UTF-8 never needs more UTF-16 units than it has bytes, reserve for that and the \0
+    // and write the characters behind the length that bound would need
+    size_t bound = (len + 1) * 2 + 1;
+    us_.Ensure(bound + 4);
+    Byte* head = us_.Tail();
+    Byte* out = head + LengthSize(bound);
+    Byte* p = out;
+    const Byte* s = (const Byte*)utf8;
+    const Byte* end = s + len;
+    int flag = 0;
+    while (s < end)
+    {
+#ifdef PELIB_SSE2
+        // sixteen ASCII characters at a time, checking for the special ones on the way
+        if (end - s >= 16)
+        {
+            __m128i c = _mm_loadu_si128((const __m128i*)s);
+            if (!_mm_movemask_epi8(c))
+            {
+                __m128i low = _mm_sub_epi8(c, _mm_set1_epi8(0x0e));
+                __m128i special = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(c, _mm_set1_epi8(8)), c),
+                                 _mm_cmpeq_epi8(_mm_min_epu8(low, _mm_set1_epi8(0x11)), low)),
+                    _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(0x27)), _mm_cmpeq_epi8(c, _mm_set1_epi8(0x2d))),
+                                 _mm_cmpeq_epi8(c, _mm_set1_epi8(0x7f))));
+                if (_mm_movemask_epi8(special))
+                    flag = 1;
+                _mm_storeu_si128((__m128i*)p, _mm_unpacklo_epi8(c, _mm_setzero_si128()));
+                _mm_storeu_si128((__m128i*)(p + 16), _mm_unpackhi_epi8(c, _mm_setzero_si128()));
+                s += 16;
+                p += 32;
+                continue;
+            }
+        }
+#endif
+        unsigned n = *s++;
+        if (n >= 0x80)
+        {
+            // anything malformed becomes U+FFFD, one per offending byte
+            unsigned lead = n;
+            n = 0xfffd;
+            if (lead >= 0xc2 && lead < 0xe0)
+            {
+                if (s < end && (s[0] & 0xc0) == 0x80)
+                    n = ((lead & 0x1f) << 6) | (*s++ & 0x3f);
+            }
+            else if (lead >= 0xe0 && lead < 0xf0)
+            {
+                if (end - s >= 2 && (s[0] & 0xc0) == 0x80 && (s[1] & 0xc0) == 0x80)
+                {
+                    unsigned cp = ((lead & 0x0f) << 12) | ((s[0] & 0x3f) << 6) | (s[1] & 0x3f);
+                    if (cp >= 0x800 && (cp < 0xd800 || cp > 0xdfff))
+                    {
+                        n = cp;
+                        s += 2;
+                    }
+                }
+            }
+            else if (lead >= 0xf0 && lead < 0xf5)
+            {
+                if (end - s >= 3 && (s[0] & 0xc0) == 0x80 && (s[1] & 0xc0) == 0x80 && (s[2] & 0xc0) == 0x80)
+                {
+                    unsigned cp = ((lead & 0x07) << 18) | ((s[0] & 0x3f) << 12) | ((s[1] & 0x3f) << 6) | (s[2] & 0x3f);
+                    if (cp >= 0x10000 && cp <= 0x10ffff)
+                    {
+                        // a surrogate pair, the high one goes out here
+                        cp -= 0x10000;
+                        unsigned high = 0xd800 + (cp >> 10);
+                        *p++ = high & 0xff;
+                        *p++ = high >> 8;
+                        n = 0xdc00 + (cp & 0x3ff);
+                        s += 3;
+                    }
+                }
+            }
+        }
+        if (SpecialUS(n))
             flag = 1;
-        us_.base[us_.size++] = n & 0xff;
-        us_.base[us_.size++] = n >> 8;
+        *p++ = n & 0xff;
+        *p++ = n >> 8;
     }
-    us_.base[us_.size++] = flag;
-    return rv;
+    // the \0 ldstr literals carry
+    *p++ = 0;
+    *p++ = 0;
+    if (SpecialUS(0))
+        flag = 1;
+    *p++ = flag;
+    size_t blobLen = p - out;
+    // the actual length may need fewer bytes than the bound did
+    Byte* start = PutLength(head, blobLen);
+    if (start != out)
+        memmove(start, out, blobLen);
+    return us_.Intern(start + blobLen - head);
 }
 size_t PEWriter::HashGUID(Byte* Guid)
 {
     guid_.Ensure(128 / 8);
     size_t rv = guid_.size;
-    memcpy(guid_.base + rv, Guid, 128 / 8);
-    guid_.size += 128 / 8;
+    memcpy(guid_.Tail(), Guid, 128 / 8);
+    guid_.Commit(128 / 8);
     return (rv / (128 / 8) + 1);
 }
 size_t PEWriter::HashBlob(Byte* blobData, size_t blobLen)
 {
     if (blob_.size == 0)
-        blob_.size++;
-    int xcount = 0;
-    blob_.Ensure(blobLen + 4);
-    size_t rv = blob_.size;
-    if (blobLen < 0x80)
-    {
-        blob_.base[blob_.size++] = blobLen;
-    }
-    else if (blobLen <= 0x3fff)
     {
-        blob_.base[blob_.size++] = (blobLen >> 8) | 0x80;
-        blob_.base[blob_.size++] = blobLen;
+        blob_.Ensure(1);
+        blob_.Commit(1);
     }
-    else
-    {
-        blobLen &= 0x1fffffff;
-        blob_.base[blob_.size++] = (blobLen >> 24) | 0xc0;
-        blob_.base[blob_.size++] = (blobLen >> 16);
-        blob_.base[blob_.size++] = (blobLen >> 8);
-        blob_.base[blob_.size++] = (blobLen >> 0);
-    }
-    memcpy(blob_.base + blob_.size, blobData, blobLen);
-    blob_.size += blobLen;
-    return rv;
+    blob_.Ensure(blobLen + 4);
+    // stage the blob past the end of the heap and let Intern decide whether to keep it
+    Byte* p = PutLength(blob_.Tail(), blobLen);
+    memcpy(p, blobData, blobLen);
+    p += blobLen;
+    return blob_.Intern(p - blob_.Tail());
+}
+size_t PEWriter::AddManifestResource(const std::string& name, DWord flags, const std::string& path)
+{
+    std::ifstream in(path.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+    if (!in)
+        throw PELibError(PELibError::NotFound, path);
+    ManifestResource resource = { path, nullptr, (size_t)in.tellg() };
+    return AddManifestResource(name, flags, resource);
+}
+size_t PEWriter::AddManifestResource(const std::string& name, DWord flags, const Byte* data, size_t size)
+{
+    if (!data && size)
+        throw PELibError(PELibError::NotSupported, "resource " + name + " without data");
+    ManifestResource resource = { std::string(), data, size };
+    return AddManifestResource(name, flags, resource);
+}
+size_t PEWriter::AddManifestResource(const std::string& name, DWord flags, const ManifestResource& resource)
+{
+    resources_.push_back(resource);
+    // each resource is a length followed by the bytes, aligned to 8
+    if (resourcesSize_ % 8)
+        resourcesSize_ += 8 - resourcesSize_ % 8;
+    DWord offset = resourcesSize_;
+    resourcesSize_ += 4 + resource.size;
+    Implementation implementation(Implementation::File, 0);  // in this file
+    return AddTableEntry(ManifestResourceTableEntry(offset, flags, HashString(name), implementation));
 }
 size_t PEWriter::RVABytes(Byte* Bytes, size_t dataLen)
 {
-    int pos = rva_.size;
-    rva_.Ensure(dataLen + pos - rva_.size);
+    rva_.Ensure(dataLen);
     size_t rv = rva_.size;
-    rva_.size += pos - rva_.size + dataLen;
-    memcpy(rva_.base + rv, Bytes, dataLen);
+    memcpy(rva_.Tail(), Bytes, dataLen);
+    rva_.Commit(dataLen);
     return rv;
 }
 
 void PEWriter::SetBaseClasses(size_t ObjectIndex, size_t ValueIndex, size_t EnumIndex, size_t SystemIndex)
 {
-    SignatureGenerator::SetObjectType(ObjectIndex);
     objectBase_ = ObjectIndex;
     valueBase_ = ValueIndex;
     enumBase_ = EnumIndex;
@@ -399,6 +840,11 @@ void PEWriter::SetBaseClasses(size_t ObjectIndex, size_t ValueIndex, size_t Enum
 
 void PEWriter::CalculateObjects(int corFlags)
 {
+    if (!entryPoint_ && !DLL_)
+        throw PELibError(PELibError::MissingEntryPoint);
+    if (compactStrings_ && strings_.size)
+        MergeStringSuffixes();
+    SortTables();
     assert( peHeader_ == 0 );
     peHeader_ = new PEHeader;
     memset(peHeader_, 0, sizeof(PEHeader));
@@ -420,9 +866,19 @@ void PEWriter::CalculateObjects(int corFlags)
     peHeader_->heap_size = 0x100000;
     peHeader_->heap_commit = 0x1000;
     peHeader_->num_rvas = 16;
+    if (pe32Plus_)
+    {
+        // the 64 bit image base and stack sizes are set by WritePEHeader
+        peHeader_->cpu_type = PE_AMD64;
+        peHeader_->magic = PE_MAGICNUM_PLUS;
+        peHeader_->nt_hdr_size = 0xf0;
+        peHeader_->flags |= PE_FILE_LARGE_ADDRESS_AWARE;
+        peHeader_->dll_flags |= 0x20;  // high entropy va
+    }
 
-    peHeader_->num_objects = 2;
-    peHeader_->header_size = sizeof(MZHeader_) + sizeof(PEHeader) + peHeader_->num_objects * sizeof(PEObject);
+    // PE32+ images have no x86 entry stub, so nothing to relocate
+    peHeader_->num_objects = pe32Plus_ ? 1 : 2;
+    peHeader_->header_size = sizeof(MZHeader_) + PEHeaderSize() + peHeader_->num_objects * sizeof(PEObject);
     if (peHeader_->header_size % fileAlign_)
     {
         peHeader_->header_size += (fileAlign_ - peHeader_->header_size % fileAlign_);
@@ -440,9 +896,12 @@ void PEWriter::CalculateObjects(int corFlags)
     strncpy(peObjects_[n].name, ".rsrc", 8);
     peObjects_[n++].flags = WINF_INITDATA | WINF_READABLE;
 */
-    strncpy(peObjects_[n].name, ".reloc", 8);
-    peObjects_[n++].flags = WINF_INITDATA | WINF_READABLE | WINF_DISCARDABLE;
-    size_t currentRVA = sizeof(MZHeader_) + sizeof(PEHeader) + peHeader_->num_objects * sizeof(PEObject);
+    if (!pe32Plus_)
+    {
+        strncpy(peObjects_[n].name, ".reloc", 8);
+        peObjects_[n++].flags = WINF_INITDATA | WINF_READABLE | WINF_DISCARDABLE;
+    }
+    size_t currentRVA = sizeof(MZHeader_) + PEHeaderSize() + peHeader_->num_objects * sizeof(PEObject);
     if (currentRVA % objectAlign_)
     {
         currentRVA += objectAlign_ - (currentRVA % objectAlign_);
@@ -450,9 +909,12 @@ void PEWriter::CalculateObjects(int corFlags)
     peObjects_[0].virtual_addr = currentRVA;
     peObjects_[0].raw_ptr = peHeader_->header_size;
     peHeader_->code_base = currentRVA;
-    peHeader_->iat_rva = currentRVA;
-    peHeader_->iat_size = 8;
-    currentRVA += peHeader_->iat_size;
+    if (!pe32Plus_)
+    {
+        peHeader_->iat_rva = currentRVA;
+        peHeader_->iat_size = 8;
+        currentRVA += peHeader_->iat_size;
+    }
     peHeader_->com_rva = currentRVA;
     peHeader_->com_size = sizeof(DotNetCOR20Header);
     currentRVA += peHeader_->com_size;
@@ -466,6 +928,8 @@ void PEWriter::CalculateObjects(int corFlags)
     // standard CIL expects ONLY bit 0, we are using bit 1 as well
     // for interoperability with the microsoft runtimes
     cor20Header_->Flags = corFlags;
+    if (pe32Plus_)
+        cor20Header_->Flags &= ~2;  // 32 bit required
     cor20Header_->EntryPointToken = entryPoint_;
 
     if (snkFile_.size())
@@ -543,6 +1007,7 @@ void PEWriter::CalculateObjects(int corFlags)
             method->rva_ = 0;
         }
     }
+    methodsEnd_ = currentRVA;
     if (currentRVA % 4)
     {
         currentRVA += 4 - currentRVA % 4;
@@ -595,14 +1060,9 @@ void PEWriter::CalculateObjects(int corFlags)
     currentRVA += sizeof(DotNetMetaTablesHeader);  // tables header
     currentRVA += n * sizeof(DWord);               // table counts;
 
+    MetaSchema schema(counts);
     for (int i = 0; i < MaxTables; i++)
-        if (counts[i])
-        {
-            Byte buffer[512];
-            n = tables_[i][0]->Render(counts, buffer);
-            n *= counts[i];
-            currentRVA += n;
-        }
+        currentRVA += schema.rowSize[i] * counts[i];
     if (currentRVA % 4)
         currentRVA += 4 - currentRVA % 4;
     //    currentRVA += 4;
@@ -633,18 +1093,32 @@ void PEWriter::CalculateObjects(int corFlags)
 
     cor20Header_->MetaData[1] = currentRVA - cor20Header_->MetaData[0];
 
-    peHeader_->import_rva = currentRVA;
-    currentRVA += sizeof(PEImportDir) * 2 + 8;
-    if (currentRVA % 16)
-        currentRVA += 16 - currentRVA % 16;
-    currentRVA += 2 + sizeof("_CorXXXMain") + sizeof("mscoree.dll") + 1;
-    peHeader_->import_size = currentRVA - peHeader_->import_rva;
-    if (currentRVA % 4)
-        currentRVA += 4 - currentRVA % 4;
+    if (resourcesSize_)
+    {
+        if (currentRVA % 8)
+            currentRVA += 8 - currentRVA % 8;
+        cor20Header_->Resources[0] = currentRVA;
+        cor20Header_->Resources[1] = resourcesSize_;
+        currentRVA += resourcesSize_;
+        if (currentRVA % 4)
+            currentRVA += 4 - currentRVA % 4;
+    }
 
-    currentRVA += 2;
-    peHeader_->entry_point = currentRVA;
-    currentRVA += 6;
+    if (!pe32Plus_)
+    {
+        peHeader_->import_rva = currentRVA;
+        currentRVA += sizeof(PEImportDir) * 2 + 8;
+        if (currentRVA % 16)
+            currentRVA += 16 - currentRVA % 16;
+        currentRVA += 2 + sizeof("_CorXXXMain") + sizeof("mscoree.dll") + 1;
+        peHeader_->import_size = currentRVA - peHeader_->import_rva;
+        if (currentRVA % 4)
+            currentRVA += 4 - currentRVA % 4;
+
+        currentRVA += 2;
+        peHeader_->entry_point = currentRVA;
+        currentRVA += 6;
+    }
     if (snkLen_)
     {
 
@@ -723,102 +1197,555 @@ void PEWriter::CalculateObjects(int corFlags)
         sect++;
 #endif
 
-    peHeader_->fixup_rva = currentRVA;
-    currentRVA += 12;  // sizeof relocs
+    if (!pe32Plus_)
+    {
+        peHeader_->fixup_rva = currentRVA;
+        currentRVA += 12;  // sizeof relocs
 
-    peObjects_[sect].virtual_size = currentRVA - peObjects_[sect].virtual_addr;
-    peHeader_->fixup_size = peObjects_[sect].virtual_size;
-    n = peObjects_[sect].virtual_size;
-    if (n % fileAlign_)
-        n += fileAlign_ - n % fileAlign_;
-    peObjects_[sect].raw_size = n;
-    peHeader_->data_size += n;
+        peObjects_[sect].virtual_size = currentRVA - peObjects_[sect].virtual_addr;
+        peHeader_->fixup_size = peObjects_[sect].virtual_size;
+        n = peObjects_[sect].virtual_size;
+        if (n % fileAlign_)
+            n += fileAlign_ - n % fileAlign_;
+        peObjects_[sect].raw_size = n;
+        peHeader_->data_size += n;
 
-    if (currentRVA % objectAlign_)
-        currentRVA += objectAlign_ - currentRVA % objectAlign_;
-    peObjects_[sect + 1].raw_ptr = peObjects_[sect].raw_ptr + peObjects_[sect].raw_size;
-    peObjects_[sect + 1].virtual_addr = currentRVA;
+        if (currentRVA % objectAlign_)
+            currentRVA += objectAlign_ - currentRVA % objectAlign_;
+        peObjects_[sect + 1].raw_ptr = peObjects_[sect].raw_ptr + peObjects_[sect].raw_size;
+        peObjects_[sect + 1].virtual_addr = currentRVA;
+    }
 
     peHeader_->image_size = currentRVA;
+
+    // yes we do NOT hash the gap between the objects table and the first section
+    unhashed_[0][0] = sizeof(MZHeader_) + PEHeaderSize() + peHeader_->num_objects * sizeof(PEObject);
+    unhashed_[0][1] = peHeader_->header_size;
+    // nor the signature itself
+    unhashed_[1][0] = cor20Header_->StrongNameSignature[0] - peObjects_[0].virtual_addr + peObjects_[0].raw_ptr;
+    unhashed_[1][1] = unhashed_[1][0] + cor20Header_->StrongNameSignature[1];
+
+    if (mvidIndex_)
+    {
+        // the guid is still zero when it is hashed
+        Byte hash[20];
+        ContentHash(hash);
+        Byte* mvid = guid_.At((mvidIndex_ - 1) * 16);
+        memcpy(mvid, hash, 16);
+        // same version bits as CreateGuid
+        mvid[7] = (mvid[7] & 0xf) | 0x40;
+        mvid[9] = (mvid[9] & 0x3f) | 0x80;
+        // the high bit tells this apart from a real time stamp
+        peHeader_->time = (hash[16] | (hash[17] << 8) | (hash[18] << 16) | (hash[19] << 24)) | 0x80000000;
+    }
 }
-void PEWriter::HashPartOfFile(SHA1Context& context, size_t offset, size_t len)
+void PEWriter::ContentHash(Byte hash[20]) const
 {
-    outputFile_->seekg(offset);
-    char buf[8192];
-    int sz = 0x0;
-    while (sz < len)
+    SHA1Context context;
+    SHA1Reset(&context);
+    for (auto heap : { &strings_, &us_, &guid_, &blob_, &rva_ })
+        for (auto&& segment : heap->segments)
+            SHA1Input(&context, segment.base, segment.used);
+    SHA1Input(&context, (Byte*)&cor20Header_->Flags, sizeof(cor20Header_->Flags));
+
+    size_t counts[MaxTables + ExtraIndexes];
+    memset(counts, 0, sizeof(counts));
+    counts[tString] = strings_.size;
+    counts[tUS] = us_.size;
+    counts[tGUID] = guid_.size;
+    counts[tBlob] = blob_.size;
+    for (int i = 0; i < MaxTables; i++)
+        counts[i] = tables_[i].size();
+    MetaSchema schema(counts);
+    std::vector<Byte> rows;
+    for (int i = 0; i < MaxTables; i++)
+        if (counts[i])
+        {
+            rows.resize(schema.rowSize[i] * counts[i]);
+            rows_[i]->Render(schema, &rows[0]);
+            SHA1Input(&context, &rows[0], rows.size());
+        }
+    for (auto method : methods_)
     {
-        int l = len - sz > 8192 ? 8192 : len - sz;
-        outputFile_->read(buf, l);
-        SHA1Input(&context, (Byte*)buf, l);
-        sz += l;
+        if (method->flags_ & PEMethod::CIL)
+        {
+            DWord header[4] = { (DWord)method->flags_, method->maxStack_, (DWord)method->codeSize_,
+                                (DWord)method->signatureToken_ };
+            SHA1Input(&context, (Byte*)header, sizeof(header));
+            SHA1Input(&context, method->code_, method->codeSize_);
+            for (const SEHData& data : method->sehData_)
+            {
+                DWord seh[6] = { (DWord)data.flags, (DWord)data.tryOffset, (DWord)data.tryLength,
+                                 (DWord)data.handlerOffset, (DWord)data.handlerLength, (DWord)data.classToken };
+                SHA1Input(&context, (Byte*)seh, sizeof(seh));
+            }
+        }
     }
+    // the resources are only read when the image is rendered, so files are read here as well
+    for (const ManifestResource& resource : resources_)
+    {
+        DWord n = resource.size;
+        SHA1Input(&context, (Byte*)&n, sizeof(n));
+        if (resource.data)
+        {
+            SHA1Input(&context, resource.data, resource.size);
+        }
+        else if (resource.size)
+        {
+            FILE* file = fopen(resource.path.c_str(), "rb");
+            if (file)
+            {
+                Byte buf[65536];
+                for (size_t len; (len = fread(buf, 1, sizeof(buf), file)) != 0;)
+                    SHA1Input(&context, buf, len);
+                fclose(file);
+            }
+        }
+    }
+    SHA1Result(&context);
+    for (int i = 0; i < 20; i++)
+        hash[i] = context.Message_Digest[i / 4] >> (24 - 8 * (i % 4));
 }
-bool PEWriter::WriteFile(int corFlags, std::iostream& out)
+size_t PEWriter::PEHeaderSize() const
+{
+    return pe32Plus_ ? sizeof(PEHeader64) : sizeof(PEHeader);
+}
+size_t PEWriter::ImageSize() const
+{
+    const PEObject& last = peObjects_[peHeader_->num_objects - 1];
+    return last.raw_ptr + last.raw_size;
+}
+void PEWriter::region(size_t size, const std::function<void(Byte*)>& render) const
+{
+    if (jobs_)
+    {
+        jobs_->push_back(std::make_pair(pos_, render));
+    }
+    else
+    {
+        render(image_ + pos_);
+        if (hash_)
+            HashImage(pos_, size);
+    }
+    pos_ += size;
+}
+size_t PEWriter::TextOffset(size_t rva) const
+{
+    return rva - peObjects_[0].virtual_addr + peObjects_[0].raw_ptr;
+}
+void PEWriter::HashImage(size_t offset, size_t len) const
+{
+    size_t end = offset + len;
+    for (int i = 0; i < 2 && offset < end; i++)
+    {
+        if (offset < unhashed_[i][0])
+        {
+            size_t n = (end < unhashed_[i][0] ? end : unhashed_[i][0]) - offset;
+            SHA1Input(hash_, image_ + offset, n);
+            offset += n;
+        }
+        if (offset < unhashed_[i][1])
+            offset = end < unhashed_[i][1] ? end : unhashed_[i][1];
+    }
+    if (offset < end)
+        SHA1Input(hash_, image_ + offset, end - offset);
+}
+bool PEWriter::WriteFile(int corFlags, std::ostream& out)
 {
-    outputFile_ = &out;
-    if (!entryPoint_ && !DLL_)
-        throw PELibError(PELibError::MissingEntryPoint);
     CalculateObjects(corFlags);
-    bool rv = WriteMZData() && WritePEHeader() && WritePEObjects() && WriteIAT() && WriteCoreHeader() &&
-              WriteStaticData() && WriteMethods() && WriteMetadataHeaders() && WriteTables() &&
-              WriteStrings() && WriteUS() && WriteGUID() && WriteBlob() && WriteImports() &&
-              WriteEntryPoint() && WriteHashData() &&
-              //        WriteVersionInfo(peLib) &&
-              WriteRelocs();
-    if (rv && snkLen_)
+    return WriteBuffered(out);
+}
+bool PEWriter::WriteFile(int corFlags, std::vector<Byte>& image)
+{
+    CalculateObjects(corFlags);
+    image.resize(ImageSize());
+    return WriteImage(&image[0]);
+}
+template <class Entry> void PEWriter::ContinueTable(const PEWriter& baseline, int table)
+{
+    for (auto row : baseline.tables_[table])
     {
-        SHA1Context context;
-        SHA1Reset(&context);
-
-        int pos = 0;
-        HashPartOfFile(context, 0, 0x80);
-        // if there was something between here and the PE header we would hash it now
-
-        // well we are supposed to zero the pe header checksum and the
-        // authenticode signature pointer, but, since we don't set them nonzero anyway
-        // this is fine.
-        HashPartOfFile(context, 0x80, 0xf8);
+        const Entry& entry = *static_cast<const Entry*>(row);
+        internedRows_.insert(std::make_pair(Key(entry), AddTableEntry<Entry>(entry)));
+    }
+}
+void PEWriter::Continue(const PEWriter& baseline)
+{
+    DLL_ = baseline.DLL_;
+    GUI_ = baseline.GUI_;
+    strings_.Continue(baseline.strings_);
+    us_.Continue(baseline.us_);
+    blob_.Continue(baseline.blob_);
+    guid_.Continue(baseline.guid_);
+    if (us_.size == 0)
+    {
+        // the image got the placeholder heap
+        us_.Ensure(sizeof(defaultUS_));
+        memcpy(us_.Tail(), defaultUS_, sizeof(defaultUS_));
+        us_.Commit(sizeof(defaultUS_));
+    }
+    // the runtime appends the heaps of a delta to the earlier ones, which are padded
+    // to four bytes, and a delta heap starts with a 0 byte just like the heap of an image
+    pool* heaps[] = { &strings_, &us_, &blob_ };
+    for (int i = 0; i < 3; i++)
+    {
+        size_t padding = (4 - heaps[i]->size % 4) % 4;
+        heaps[i]->Ensure(padding + 1);
+        memset(heaps[i]->Tail(), 0, padding + 1);
+        heaps[i]->Commit(padding);
+        deltaHeaps_[i] = heaps[i]->size;
+        heaps[i]->Commit(1);
+    }
+    deltaHeaps_[3] = guid_.size;
+    ContinueTable<TypeRefTableEntry>(baseline, tTypeRef);
+    ContinueTable<MemberRefTableEntry>(baseline, tMemberRef);
+    ContinueTable<TypeSpecTableEntry>(baseline, tTypeSpec);
+    ContinueTable<StandaloneSigTableEntry>(baseline, tStandaloneSig);
+    ContinueTable<AssemblyRefTableEntry>(baseline, tAssemblyRef);
+    ContinueTable<ModuleRefTableEntry>(baseline, tModuleRef);
+    ContinueTable<MethodSpecTableEntry>(baseline, tMethodSpec);
+}
+bool PEWriter::WriteDelta(const PEWriter& baseline, std::vector<Byte>& metadata, std::vector<Byte>& il)
+{
+    SortTables();
+    // the columns of a delta are all four bytes wide, the rows are compared that way as well
+    size_t wide[MaxTables + ExtraIndexes];
+    for (auto&& size : wide)
+        size = 1 << 24;
+    MetaSchema schema(wide);
 
-        HashPartOfFile(context, 0x80 + 0xf8, sizeof(PEObject) * peHeader_->num_objects);
+    // find the new rows. Rows are referred to by their index, so those of the baseline
+    // have to come first in each table. Only in the sorted tables whose rows nothing
+    // refers to, new rows may lie in between, the runtime appends them all the same
+    std::vector<size_t> added[MaxTables];
+    std::vector<Byte> before, after;
+    for (int n = 0; n < MaxTables; n++)
+    {
+        // the module row is made below, the assembly gets its key when the image is laid out
+        const size_t count = baseline.tables_[n].size(), size = schema.rowSize[n];
+        if (n == tModule || n == tAssemblyDef || (tables_[n].empty() && !count))
+            continue;
+        before.resize(count * size);
+        after.resize(tables_[n].size() * size);
+        if (count)
+            baseline.rows_[n]->Render(schema, &before[0]);
+        if (!tables_[n].empty())
+            rows_[n]->Render(schema, &after[0]);
+        if (n == tMethodDef)
+        {
+            // the body is compared by itself
+            for (size_t i = 0; i < before.size(); i += size)
+                memset(&before[i], 0, 4);
+            for (size_t i = 0; i < after.size(); i += size)
+                memset(&after[i], 0, 4);
+        }
+        bool inBetween = std::find(std::begin(sortedTables_), std::end(sortedTables_), n) != std::end(sortedTables_) &&
+                         n != tInterfaceImpl && n != tGenericParam && n != tGenericParamConstraint;
+        size_t i = 0;
+        for (size_t j = 0; j < tables_[n].size(); j++)
+        {
+            if (i < count && !memcmp(&before[i * size], &after[j * size], size))
+                i++;
+            else if (i < count && !inBetween)
+                break;
+            else
+                added[n].push_back(j);
+        }
+        if (i < count)
+            throw PELibError(PELibError::NotSupported, std::string("changing ") + tableNames[n] + " rows in a delta");
+    }
+    // the data of these would have to go into the image
+    for (int n : { tFieldRVA, tManifestResource, tFile, tExportedType })
+        if (!added[n].empty())
+            throw PELibError(PELibError::NotSupported, std::string("adding ") + tableNames[n] + " rows in a delta");
 
-        // yes we do NOT hash the gap between the objects table and the first section
-        for (int i = 0; i < peHeader_->num_objects; i++)
+    // the IL delta holds the bodies which changed and those of the new methods
+    auto render = [](const PEMethod* method, std::vector<Byte>& body) {
+        body.resize(12 + method->codeSize_ + 3 + 4 + method->sehData_.size() * 24);
+        body.resize(method->Write(nullptr, &body[0]));
+    };
+    std::vector<const PEMethod*> previous(baseline.tables_[tMethodDef].size() + 1);
+    for (auto method : baseline.methods_)
+        if (method->flags_ & PEMethod::CIL)
+            previous[method->methodDef_] = method;
+    std::vector<PEMethod*> bodies;
+    std::vector<size_t> updated;
+    for (auto method : methods_)
+    {
+        method->rva_ = 0;
+        if (!(method->flags_ & PEMethod::CIL))
+            continue;
+        if (method->methodDef_ < previous.size())
         {
-            if (peObjects_[i].virtual_addr < cor20Header_->StrongNameSignature[0] &&
-                cor20Header_->StrongNameSignature[0] < peObjects_[i].virtual_addr + peObjects_[i].virtual_size)
+            if (previous[method->methodDef_])
             {
-                int offs = cor20Header_->StrongNameSignature[0] - peObjects_[i].virtual_addr;
-                int sz = cor20Header_->StrongNameSignature[1];
-                HashPartOfFile(context, peObjects_[i].raw_ptr, offs);
-                HashPartOfFile(context, peObjects_[i].raw_ptr + offs + sz, peObjects_[i].raw_size - offs - sz);
+                render(method, after);
+                render(previous[method->methodDef_], before);
+                if (after == before)
+                    continue;
             }
-            else
+            updated.push_back(method->methodDef_);
+        }
+        bodies.push_back(method);
+    }
+    std::sort(bodies.begin(), bodies.end(),
+              [](const PEMethod* left, const PEMethod* right) { return left->methodDef_ < right->methodDef_; });
+    std::sort(updated.begin(), updated.end());
+    // an rva of 0 would mean there is no body
+    il.assign(4, 0);
+    for (auto method : bodies)
+    {
+        if ((method->flags_ & 3) == PEMethod::FatFormat)
+            il.resize((il.size() + 3) & ~3, 0);
+        method->rva_ = il.size();
+        render(method, after);
+        il.insert(il.end(), after.begin(), after.end());
+    }
+
+    // the module row names this generation and the one it applies to
+    ModuleTableEntry* module = static_cast<ModuleTableEntry*>(tables_[tModule][0]);
+    const ModuleTableEntry* previousModule = static_cast<const ModuleTableEntry*>(baseline.tables_[tModule][0]);
+    module->generation_ = previousModule->generation_ + 1;
+    module->nameIndex_ = previousModule->nameIndex_;
+    // unlike the other heaps, the #GUID heap of a delta is read as a whole, so the
+    // guids of the baseline it refers to are added to it again
+    auto guidAgain = [&](size_t index) -> size_t {
+        Byte guid[16];
+        if (!index)
+            return 0;
+        baseline.GetGuid(index, guid);
+        return HashGUID(guid);
+    };
+    module->encIdIndex_ = module->guidIndex_;
+    module->guidIndex_ = guidAgain(previousModule->guidIndex_.index_);
+    module->encBaseIdIndex_ = guidAgain(previousModule->encIdIndex_.index_);
+
+    // log the rows in the order the runtime applies them: the references, then the
+    // definitions, members right after the parent they are added to
+    DNLTable delta[MaxTables];
+    delta[tModule].push_back(module);
+    std::vector<EncLogTableEntry> log;
+    std::vector<DWord> tokens;
+    bool logged[MaxTables] = {};
+    auto logRows = [&](int n, int parent, DWord funcCode, size_t (*list)(const TableEntryBase*)) {
+        logged[n] = true;
+        for (size_t k = 0; k < added[n].size(); k++)
+        {
+            DWord token = (n << 24) + baseline.tables_[n].size() + k + 1;
+            if (funcCode)
             {
-                HashPartOfFile(context, peObjects_[i].raw_ptr, peObjects_[i].raw_size);
+                // members are added at the end of their tables, so the parent is the last
+                // row whose list starts at or before them
+                size_t owner = tables_[parent].size();
+                while (owner > 1 && list(tables_[parent][owner - 1]) > (token & 0xffffff))
+                    owner--;
+                log.push_back(EncLogTableEntry((parent << 24) + owner, funcCode));
             }
+            log.push_back(EncLogTableEntry(token, EncLogTableEntry::Default));
+            tokens.push_back(token);
+            delta[n].push_back(tables_[n][added[n][k]]);
         }
+    };
+    for (int n : { tAssemblyRef, tModuleRef, tMemberRef, tMethodSpec, tTypeRef, tTypeSpec, tStandaloneSig, tTypeDef,
+                   tEventMap, tPropertyMap })
+        logRows(n, 0, EncLogTableEntry::Default, nullptr);
+    logRows(tField, tTypeDef, EncLogTableEntry::AddField, [](const TableEntryBase* row) -> size_t {
+        return static_cast<const TypeDefTableEntry*>(row)->fields_.index_;
+    });
+    for (size_t index : updated)
+    {
+        log.push_back(EncLogTableEntry((tMethodDef << 24) + index, EncLogTableEntry::Default));
+        tokens.push_back((tMethodDef << 24) + index);
+        delta[tMethodDef].push_back(tables_[tMethodDef][index - 1]);
+    }
+    logRows(tMethodDef, tTypeDef, EncLogTableEntry::AddMethod, [](const TableEntryBase* row) -> size_t {
+        return static_cast<const TypeDefTableEntry*>(row)->methods_.index_;
+    });
+    logRows(tEvent, tEventMap, EncLogTableEntry::AddEvent, [](const TableEntryBase* row) -> size_t {
+        return static_cast<const EventMapTableEntry*>(row)->eventList_.index_;
+    });
+    logRows(tProperty, tPropertyMap, EncLogTableEntry::AddProperty, [](const TableEntryBase* row) -> size_t {
+        return static_cast<const PropertyMapTableEntry*>(row)->propertyList_.index_;
+    });
+    logRows(tParam, tMethodDef, EncLogTableEntry::AddParameter, [](const TableEntryBase* row) -> size_t {
+        return static_cast<const MethodDefTableEntry*>(row)->paramIndex_.index_;
+    });
+    for (int n = 0; n < MaxTables; n++)
+        if (!logged[n])
+            logRows(n, 0, EncLogTableEntry::Default, nullptr);
+    for (auto&& entry : log)
+        delta[tEncLog].push_back(&entry);
+    std::sort(tokens.begin(), tokens.end());
+    std::vector<EncMapTableEntry> map(tokens.begin(), tokens.end());
+    for (auto&& entry : map)
+        delta[tEncMap].push_back(&entry);
+
+    // the streams: tables, the new parts of the heaps and an empty #JTD, which
+    // tells the runtime the heaps hold only what was added
+    std::vector<Byte> streams[6];
+    DotNetMetaTablesHeader header;
+    memset(&header, 0, sizeof(header));
+    header.MajorVersion = 2;
+    header.Reserved2 = 1;
+    header.HeapOffsetSizes = 1 | 2 | 4 | 0x20 | 0x80;  // wide columns, delta, deleted marks
+    header.MaskSorted = (((longlong)0x1600) << 32) + (0x3325FA00);
+    size_t size = sizeof(header);
+    for (int n = 0; n < MaxTables; n++)
+        if (!delta[n].empty())
+        {
+            header.MaskValid |= ((longlong)1) << n;
+            size += 4 + delta[n].size() * schema.rowSize[n];
+        }
+    streams[0].resize(size);
+    Byte* p = &streams[0][0];
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    for (int n = 0; n < MaxTables; n++)
+        if (!delta[n].empty())
+        {
+            *(DWord*)p = delta[n].size();
+            p += 4;
+        }
+    for (int n = 0; n < MaxTables; n++)
+        for (auto row : delta[n])
+            p += row->Render(schema, p);
+    const pool* heaps[] = { &strings_, &us_, &guid_, &blob_ };
+    const size_t starts[] = { deltaHeaps_[0], deltaHeaps_[1], deltaHeaps_[3], deltaHeaps_[2] };
+    auto copy = [&](int i) {
+        streams[i + 1].resize(heaps[i]->size - starts[i]);
+        if (!streams[i + 1].empty())
+            heaps[i]->CopyTo(&streams[i + 1][0], starts[i]);
+    };
+    copy(0);
+    copy(1);
+    copy(3);
+    Byte* encId = guid_.At((module->encIdIndex_.index_ - 1) * 16);
+    static const Byte zero[16] = { 0 };
+    if (!memcmp(encId, zero, sizeof(zero)))
+    {
+        // a deterministic module, the guid is derived from the rest of the delta
+        SHA1Context context;
+        SHA1Reset(&context);
+        for (auto&& stream : streams)
+            if (!stream.empty())
+                SHA1Input(&context, &stream[0], stream.size());
+        SHA1Input(&context, &il[0], il.size());
+        SHA1Result(&context);
+        for (int i = 0; i < 16; i++)
+            encId[i] = context.Message_Digest[i / 4] >> (24 - 8 * (i % 4));
+        // same version bits as CreateGuid
+        encId[7] = (encId[7] & 0xf) | 0x40;
+        encId[9] = (encId[9] & 0x3f) | 0x80;
+    }
+    // the guids before the delta's own are left zero, the runtime skips them
+    streams[3].assign(guid_.size, 0);
+    guid_.CopyTo(&streams[3][starts[2]], starts[2]);
+    for (auto&& stream : streams)
+        stream.resize((stream.size() + 3) & ~3, 0);
 
+    // the metadata root and the stream headers, and the streams after them
+    static const char* const names[6] = { "#-", "#Strings", "#US", "#GUID", "#Blob", "#JTD" };
+    const DWord versionSize = (sizeof(RTV_STRING) + 3) & ~3;
+    size_t offset = sizeof(DotNetMetaHeader) + 4 + versionSize + 4;
+    for (auto name : names)
+        offset += 8 + ((strlen(name) + 1 + 3) & ~3);
+    metadata.assign(offset, 0);
+    p = &metadata[0];
+    memcpy(p, metaHeader_, sizeof(DotNetMetaHeader));
+    p += sizeof(DotNetMetaHeader);
+    *(DWord*)p = versionSize;
+    memcpy(p + 4, RTV_STRING, sizeof(RTV_STRING));
+    p += 4 + versionSize;
+    *(Word*)(p + 2) = 6;  // no flags, six streams
+    p += 4;
+    for (int i = 0; i < 6; i++)
+    {
+        *(DWord*)p = offset;
+        *(DWord*)(p + 4) = streams[i].size();
+        strcpy((char*)p + 8, names[i]);
+        p += 8 + ((strlen(names[i]) + 1 + 3) & ~3);
+        offset += streams[i].size();
+    }
+    for (auto&& stream : streams)
+        metadata.insert(metadata.end(), stream.begin(), stream.end());
+    return true;
+}
+bool PEWriter::WriteBuffered(std::ostream& out)
+{
+    std::vector<Byte> image(ImageSize());
+    if (!WriteImage(&image[0]))
+        return false;
+    out.write((char*)&image[0], image.size());
+    return out.good();
+}
+bool PEWriter::WriteImage(Byte* image)
+{
+    image_ = image;
+    pos_ = 0;
+    SHA1Context context;
+    Jobs jobs;
+    // a thread is only worth starting for every megabyte or so of the image, so smaller
+    // images are rendered inline; the calling thread takes its share of the regions
+    workers_ = std::min<size_t>(std::thread::hardware_concurrency(), ImageSize() / parallelSize);
+    if (snkLen_)
+    {
+        // the image is rendered strictly in file order, so it is hashed as it goes
+        SHA1Reset(&context);
+        hash_ = &context;
+    }
+    else if (workers_ > 1)
+    {
+        // the headers are put right away, the big regions are left to the workers
+        jobs_ = &jobs;
+    }
+    bool rv = WriteMZData() && WritePEHeader() && WritePEObjects() && WriteIAT() && WriteCoreHeader() &&
+              WriteStaticData() && WriteMethods() && WriteMetadataHeaders() && WriteTables() &&
+              WriteStrings() && WriteUS() && WriteGUID() && WriteBlob() && WriteResources() && WriteImports() &&
+              WriteEntryPoint() && WriteHashData() &&
+              //        WriteVersionInfo(peLib) &&
+              WriteRelocs();
+    assert( !rv || pos_ == ImageSize() );
+    hash_ = nullptr;
+    jobs_ = nullptr;
+    if (!jobs.empty())
+    {
+        std::atomic<size_t> next(0);
+        auto work = [&]() {
+            for (size_t n; (n = next++) < jobs.size(); )
+                jobs[n].second(image_ + jobs[n].first);
+        };
+        std::vector<std::thread> threads;
+        for (unsigned i = 1; i < workers_; i++)
+            threads.push_back(std::thread(work));
+        work();
+        for (auto& thread : threads)
+            thread.join();
+    }
+    if (incomplete_)
+        rv = false;
+    if (rv && snkLen_)
+    {
         SHA1Result(&context);
         Byte sigHash[16384];
         memset(sigHash, 0xfe, 128);
         size_t sigLen = 0;
         rsaEncoder.GetStrongNameSignature(sigHash, &sigLen, (Byte*)context.Message_Digest, 20);
-        outputFile_->seekp(snkBase_);
-        outputFile_->write((char*)sigHash, sigLen);
+        seek(snkBase_);
+        put(sigHash, sigLen);
     }
+    image_ = nullptr;
     return rv;
 }
 void PEWriter::align(size_t algn) const
 {
-    size_t n = offset();
-    if (n % algn)
+    size_t n = pos_ % algn;
+    if (n)
     {
-        // assumes the alignments are 65536 or less
-        Byte buf[65536];
-        n = algn - n % algn;
-        memset(buf, 0, n);
-        put(buf, n);
+        n = algn - n;
+        memset(image_ + pos_, 0, n);
+        if (hash_)
+            HashImage(pos_, n);
+        pos_ += n;
     }
 }
 bool PEWriter::WriteMZData() const
@@ -828,8 +1755,37 @@ bool PEWriter::WriteMZData() const
 }
 bool PEWriter::WritePEHeader()
 {
-    peBase_ = outputFile_->tellp();
-    put(peHeader_, sizeof(PEHeader));
+    peBase_ = offset();
+    const Byte* header = (Byte*)peHeader_;
+    PEHeader64 header64;
+    size_t security = offsetof(PEHeader, security_rva);
+    if (pe32Plus_)
+    {
+        // everything up to the image base, between the image base and the stack sizes and
+        // from the loader flags on has the same layout
+        memcpy(&header64, peHeader_, offsetof(PEHeader, data_base));
+        header64.image_base = DLL_ ? 0x180000000LL : 0x140000000LL;
+        memcpy(&header64.object_align, &peHeader_->object_align,
+               offsetof(PEHeader, stack_size) - offsetof(PEHeader, object_align));
+        header64.stack_size = 0x400000;
+        header64.stack_commit = 0x4000;
+        header64.heap_size = 0x100000;
+        header64.heap_commit = 0x2000;
+        memcpy(&header64.loader_flags, &peHeader_->loader_flags, sizeof(PEHeader) - offsetof(PEHeader, loader_flags));
+        header = (Byte*)&header64;
+        security = offsetof(PEHeader64, security_rva);
+    }
+    memcpy(image_ + pos_, header, PEHeaderSize());
+    pos_ += PEHeaderSize();
+    if (hash_)
+    {
+        // the checksum and the authenticode signature pointer are hashed as zero
+        Byte hashed[sizeof(PEHeader64)];
+        memcpy(hashed, header, PEHeaderSize());
+        memset(hashed + offsetof(PEHeader, chekcsum), 0, sizeof(peHeader_->chekcsum));
+        memset(hashed + security, 0, sizeof(peHeader_->security_rva) + sizeof(peHeader_->security_size));
+        SHA1Input(hash_, hashed, PEHeaderSize());
+    }
     return true;
 }
 bool PEWriter::WritePEObjects() const
@@ -840,6 +1796,8 @@ bool PEWriter::WritePEObjects() const
 bool PEWriter::WriteIAT() const
 {
     align(fileAlign_);
+    if (pe32Plus_)
+        return true;
     DWord n = peHeader_->import_rva;
     n += sizeof(PEImportDir) * 2 + 4;
     if (n % 16)
@@ -851,13 +1809,14 @@ bool PEWriter::WriteIAT() const
 }
 bool PEWriter::WriteCoreHeader()
 {
-    corBase_ = outputFile_->tellp();
+    corBase_ = offset();
     put(cor20Header_, sizeof(DotNetCOR20Header));
     return true;
 }
 bool PEWriter::WriteHashData()
 {
-    snkBase_ = outputFile_->tellp();
+    snkBase_ = offset();
+    assert( !snkLen_ || snkBase_ == unhashed_[1][0] );
     if (snkLen_)
     {
         Byte buf[2048];
@@ -867,6 +1826,27 @@ bool PEWriter::WriteHashData()
     return true;
 }
 bool PEWriter::WriteMethods() const
+{
+    // the bodies go out in chunks of consecutive methods, each chunk reaching
+    // up to the first body of the next one
+    size_t chunk = methods_.size();
+    if (jobs_)
+        chunk = chunk / (4 * workers_) + 1;
+    std::list<PEMethod*>::const_iterator first = methods_.begin();
+    while (first != methods_.end())
+    {
+        std::list<PEMethod*>::const_iterator last = first;
+        for (size_t n = 0; last != methods_.end() && (n < chunk || !((*last)->flags_ & PEMethod::CIL)); n++)
+            ++last;
+        size_t start = offset();
+        size_t size = (last == methods_.end() ? TextOffset(methodsEnd_) : TextOffset((*last)->rva_)) - start;
+        region(size, [this, first, last, start, size](Byte* dest) { WriteMethods(first, last, start, size, dest); });
+        first = last;
+    }
+    return true;
+}
+void PEWriter::WriteMethods(std::list<PEMethod*>::const_iterator first, std::list<PEMethod*>::const_iterator last,
+                            size_t start, size_t size, Byte* dest) const
 {
     size_t counts[MaxTables + ExtraIndexes];
     memset(counts, 0, sizeof(counts));
@@ -879,18 +1859,18 @@ bool PEWriter::WriteMethods() const
     {
         counts[i] = tables_[i].size();
     }
-    for (std::list<PEMethod*>::const_iterator it = methods_.begin(); it != methods_.end(); ++it)
+    size_t n = 0;
+    for (; first != last; ++first)
     {
-        if ((*it)->flags_ & PEMethod::CIL)
+        if ((*first)->flags_ & PEMethod::CIL)
         {
-            if (((*it)->flags_ & 3) == PEMethod::FatFormat)
-            {
-                align(4);
-            }
-            (*it)->Write(counts, *outputFile_);
+            // fat headers are aligned
+            size_t pos = TextOffset((*first)->rva_) - start;
+            memset(dest + n, 0, pos - n);
+            n = pos + (*first)->Write(counts, dest + pos);
         }
     }
-    return true;
+    memset(dest + n, 0, size - n);
 }
 bool PEWriter::WriteMetadataHeaders() const
 {
@@ -934,15 +1914,12 @@ bool PEWriter::WriteTables() const
         }
     }
 
+    MetaSchema schema(counts);
     for (int i = 0; i < MaxTables; i++)
     {
         DWord n = tables_[i].size();
-        for (int j = 0; j < n; j++)
-        {
-            Byte buffer[512];
-            DWord sz = tables_[i][j]->Render(counts, buffer);
-            put(buffer, sz);
-        }
+        if (n)
+            region(n * schema.rowSize[i], [this, i, schema](Byte* dest) { rows_[i]->Render(schema, dest); });
     }
     align(4);
     //    DWord n = 0;
@@ -951,7 +1928,7 @@ bool PEWriter::WriteTables() const
 }
 bool PEWriter::WriteStrings() const
 {
-    put(strings_.base, strings_.size);
+    region(strings_.size, [this](Byte* dest) { strings_.CopyTo(dest); });
     align(4);
     return true;
 }
@@ -963,25 +1940,61 @@ bool PEWriter::WriteUS() const
     }
     else
     {
-        put(us_.base, us_.size);
+        region(us_.size, [this](Byte* dest) { us_.CopyTo(dest); });
     }
     align(4);
     return true;
 }
 bool PEWriter::WriteGUID() const
 {
-    put(guid_.base, guid_.size);
+    region(guid_.size, [this](Byte* dest) { guid_.CopyTo(dest); });
     align(4);
     return true;
 }
 bool PEWriter::WriteBlob() const
 {
-    put(blob_.base, blob_.size);
+    region(blob_.size, [this](Byte* dest) { blob_.CopyTo(dest); });
+    align(4);
+    return true;
+}
+bool PEWriter::WriteResources() const
+{
+    for (const ManifestResource& resource : resources_)
+    {
+        align(8);
+        DWord n = resource.size;
+        put(&n, sizeof(n));
+        if (resource.path.empty())
+        {
+            if (resource.size)
+                region(resource.size, [&resource](Byte* dest) { memcpy(dest, resource.data, resource.size); });
+        }
+        else
+        {
+            // read straight into the image, no copy of the file is kept anywhere else
+            region(resource.size, [this, &resource](Byte* dest) {
+                size_t n = 0;
+                FILE* file = fopen(resource.path.c_str(), "rb");
+                if (file)
+                {
+                    n = fread(dest, 1, resource.size, file);
+                    fclose(file);
+                }
+                if (n != resource.size)
+                {
+                    memset(dest + n, 0, resource.size - n);
+                    incomplete_ = true;
+                }
+            });
+        }
+    }
     align(4);
     return true;
 }
 bool PEWriter::WriteImports() const
 {
+    if (pe32Plus_)
+        return true;
     PEImportDir dir[2];
     memset(&dir, 0, sizeof(dir));
     dir[0].thunkPos2 = peHeader_->import_rva + 2 * sizeof(PEImportDir);
@@ -1009,6 +2022,8 @@ bool PEWriter::WriteImports() const
 }
 bool PEWriter::WriteEntryPoint() const
 {
+    if (pe32Plus_)
+        return true;
     DWord n = 0;
     put(&n, 2);
     n = 0x25ff;  // JMP[xxx];
@@ -1022,7 +2037,7 @@ bool PEWriter::WriteStaticData() const
 {
     if (rva_.size)
     {
-        put(rva_.base, rva_.size);
+        region(rva_.size, [this](Byte* dest) { rva_.CopyTo(dest); });
         align(8);
     }
     return true;
@@ -1164,6 +2179,8 @@ bool PEWriter::WriteVersionInfo(const std::string& fileName) const
 bool PEWriter::WriteRelocs() const
 {
     align(fileAlign_);
+    if (pe32Plus_)
+        return true;
     DWord n = peHeader_->entry_point + 2;
     Word n1 = (PE_FIXUP_HIGHLOW << 12) | (n & 0xfff);
     n &= ~0xfff;
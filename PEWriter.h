@@ -5,6 +5,14 @@
 #include <map>
 #include <string>
 #include <list>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <iosfwd>
+#include <functional>
+#include <atomic>
+#include <cassert>
+#include <string.h>
 #include "RSAEncoder.h"
 #include "PEMetaTables.h"
 #include "SEHData.h"
@@ -14,6 +22,7 @@ namespace DotNetPELib {
 class TableEntryBase;
 class PEMethod;
 class SHA1Context;
+struct PEStatistics;
 
 typedef std::vector<TableEntryBase *> DNLTable;
 typedef unsigned short Word; /* two bytes */
@@ -27,28 +36,68 @@ public:
     // the maximum number of PE objects we will generate
     // this includes the following:
     //   .text / cildata
-    //   .reloc (for the single necessary reloc entry)
+    //   .reloc (for the single necessary reloc entry, PE32 only)
     //   .rsrc (not implemented yet, will hold version info record)
     enum { MAX_PE_OBJECTS = 4 };
 
     // Constructor to instantiate class
-    PEWriter(bool isexe, bool gui, const std::string& snkFile) : DLL_(!isexe), GUI_(gui), objectBase_(0), valueBase_(0), enumBase_(0),
-        systemIndex_(0), entryPoint_(0), paramAttributeType_(0), paramAttributeData_(0),
-        fileAlign_(0x200), objectAlign_(0x2000), imageBase_(0x400000), language_(0x4b0),
+    PEWriter(bool isexe, bool gui, const std::string& snkFile) : image_(nullptr), pos_(0), hash_(nullptr), jobs_(nullptr), workers_(0),
+        resourcesSize_(0), incomplete_(false), snkFile_(snkFile), entryPoint_(0), objectBase_(0), valueBase_(0), enumBase_(0),
+        systemIndex_(0), paramAttributeType_(0), paramAttributeData_(0), DLL_(!isexe), GUI_(gui),
+        fileAlign_(0x200), objectAlign_(0x2000), imageBase_(0x400000), language_(0x4b0), pe32Plus_(false), compactStrings_(false),
         peHeader_(nullptr), peObjects_(nullptr), cor20Header_(nullptr), tablesHeader_(nullptr),
-        snkFile_(snkFile), snkLen_(0), outputFile_(nullptr), peBase_(0), corBase_(0), snkBase_(0) { }
+        snkLen_(0), mvidIndex_(0), peBase_(0), corBase_(0), snkBase_(0)
+    {
+        memset(deltaHeaps_, 0, sizeof(deltaHeaps_));
+    }
     virtual ~PEWriter();
     // add an entry to one of the tables
     // note the data for the table will be a class inherited from TableEntryBase,
-    // and this class will self-report the table index to use
-    size_t AddTableEntry(TableEntryBase *entry);
+    // and this class will self-report the table index to use. The row is copied
+    // into storage kept per table, so callers pass it by value
+    template <class Entry> size_t AddTableEntry(const Entry &entry)
+    {
+        const int n = entry.TableIndex();
+        if (!rows_[n])
+            rows_[n].reset(new TableRows<Entry>);
+        // the storage is typed, so a table holds rows of one entry type only
+        assert( dynamic_cast<TableRows<Entry> *>(rows_[n].get()) );
+        std::deque<Entry> &rows = static_cast<TableRows<Entry> *>(rows_[n].get())->rows;
+        rows.push_back(entry);
+        tables_[n].push_back(&rows.back());
+        return tables_[n].size();
+    }
+    // reference rows are interned: adding a row equal to an earlier one returns
+    // the index of that row. The heaps are interned as well, so rows are equal
+    // when their columns are
+    size_t AddTableEntry(const TypeRefTableEntry &entry);
+    size_t AddTableEntry(const MemberRefTableEntry &entry);
+    size_t AddTableEntry(const TypeSpecTableEntry &entry);
+    size_t AddTableEntry(const AssemblyRefTableEntry &entry);
+    // so are standalone signatures, methods with the same locals share one token
+    size_t AddTableEntry(const StandaloneSigTableEntry &entry);
+    // and module references and generic method instantiations
+    size_t AddTableEntry(const ModuleRefTableEntry &entry);
+    size_t AddTableEntry(const MethodSpecTableEntry &entry);
     // add a method entry to the output list.  Note that Index_(D methods won't be added here.
     void AddMethod(PEMethod *method);
     // various functions to throw things into one of the streams, they return the stream index
     size_t HashString(const std::string& utf8);
-    size_t HashUS(wchar_t* str, int len);
+    // the same with a hash from StringHash, for callers that add a name repeatedly
+    size_t HashString(const std::string& utf8, size_t hash);
+    static size_t StringHash(const std::string& utf8);
+    size_t HashUS(const wchar_t* str, int len);
+    size_t HashUS(const Word* str, int len);
+    // transcodes len bytes of UTF-8 and appends the \0 that ldstr literals carry
+    size_t HashUS(const char* utf8, int len);
     size_t HashGUID(Byte *Guid);
     size_t HashBlob(Byte *blobData, size_t blobLen);
+    // add a managed resource, the bytes are read from path only when the image is
+    // rendered. Returns the ManifestResource table index
+    size_t AddManifestResource(const std::string& name, DWord flags, const std::string& path);
+    // the same for bytes owned by the caller, they must stay valid until the image is written.
+    // data may only be null for an empty resource
+    size_t AddManifestResource(const std::string& name, DWord flags, const Byte *data, size_t size);
     // this is the 'cildata' contents.   Again we emit into the cildata and it returns the offset in
     // the cildata to use.  It does NOT return the rva immediately, that is calculated later
     size_t RVABytes(Byte *bytes, size_t data);
@@ -76,10 +125,40 @@ public:
     size_t ParamAttributeData() const { return paramAttributeData_; }
 
     static void CreateGuid(Byte *Guid);
+    void GetGuid(size_t index, Byte *Guid) const { memcpy(Guid, guid_.At((index - 1) * 16), 16); }
+    // fills in the sizes of the tables, heaps and method bodies once the image is laid out
+    void GetStatistics(PEStatistics &statistics) const;
+    // derive the timestamp and the guid at mvidIndex from a hash of the contents
+    // of the module when the image is laid out
+    void Deterministic(size_t mvidIndex) { mvidIndex_ = mvidIndex; }
+    // write a PE32+ image for AMD64; it needs neither the mscoree import
+    // nor the x86 entry stub and its relocation
+    void PE32Plus(bool pe32Plus) { pe32Plus_ = pe32Plus; }
+    // store names which are the tail of a longer name (Value in get_Value) as an
+    // offset into the longer one when the image is laid out
+    void CompactStrings(bool compact) { compactStrings_ = compact; }
 
     size_t NextTableIndex(int table) const;
-    bool WriteFile(int corFlags, std::iostream &out);
-    void HashPartOfFile(SHA1Context &context, size_t offset, size_t len);
+    // lays out the image, renders it into one contiguous buffer and hands that
+    // to out with a single write
+    bool WriteFile(int corFlags, std::ostream &out);
+    // lays out the image, creates fileName at the final size and renders
+    // the image straight into a memory mapping of it
+    bool WriteFile(int corFlags, const std::string& fileName);
+    // lays out the image and renders it straight into image, which is resized to fit
+    bool WriteFile(int corFlags, std::vector<Byte>& image);
+    // start out with copies of the heaps and the reference rows of baseline, a writer
+    // which wrote its image, so that what is dumped into this one again keeps its
+    // offset or token there. Call it before anything is added
+    void Continue(const PEWriter& baseline);
+    // after the module was dumped into a writer set up by Continue, write the metadata and
+    // IL deltas which turn the module of baseline into this one, as MetadataUpdater.ApplyUpdate
+    // takes them. Method bodies may change; rows may be added, but throws NotSupported when the
+    // rows baseline had changed or moved
+    bool WriteDelta(const PEWriter& baseline, std::vector<Byte>& metadata, std::vector<Byte>& il);
+    // writes image to fileName by way of a temporary file and an atomic rename,
+    // unless fileName already holds exactly these bytes
+    static bool PublishFile(const std::string& fileName, const std::vector<Byte>& image);
 
     // another thing that makes this lib not thread safe, the RVA for
     // the beginning of the .data section gets put here after it is calculated
@@ -89,6 +168,15 @@ protected:
     // when we actually generate the data.   This must be kept in sync with the code to
     // generate data
     void CalculateObjects(int corFlags);
+    size_t PEHeaderSize() const;
+    // a SHA-1 over the heaps, the table rows, the method bodies and the resources
+    void ContentHash(Byte hash[20]) const;
+    // the size of the file laid out by CalculateObjects
+    size_t ImageSize() const;
+    // renders the laid out file into image, which must hold ImageSize() bytes
+    bool WriteImage(Byte *image);
+    // renders the laid out file into a temporary buffer and writes that to out
+    bool WriteBuffered(std::ostream &out);
     // These functions put various information into the PE file
     bool WriteMZData() const; //
     bool WritePEHeader();//
@@ -98,12 +186,15 @@ protected:
     bool WriteHashData();
     bool WriteStaticData() const;
     bool WriteMethods() const;
+    void WriteMethods(std::list<PEMethod *>::const_iterator first, std::list<PEMethod *>::const_iterator last,
+                      size_t start, size_t size, Byte *dest) const;
     bool WriteMetadataHeaders() const;//
     bool WriteTables() const;
     bool WriteStrings() const;
     bool WriteUS() const;
     bool WriteGUID() const;
     bool WriteBlob() const;
+    bool WriteResources() const;
     bool WriteImports() const;
     bool WriteEntryPoint() const;
 
@@ -114,25 +205,162 @@ protected:
     void VersionString(const wchar_t *name, const char *value) const;
 
     // Various helpers to put data to the output
-    void put(const void *data, size_t size) const { outputFile_->write((char *)data, size); }
-    std::streamoff offset() const { return outputFile_->tellp(); }
-    void seek(size_t offset) const { outputFile_->seekp(offset); }
+    void put(const void *data, size_t size) const
+    {
+        memcpy(image_ + pos_, data, size);
+        if (hash_)
+            HashImage(pos_, size);
+        pos_ += size;
+    }
+    size_t offset() const { return pos_; }
+    void seek(size_t offset) const { pos_ = offset; }
     void align(size_t offset) const;
+    // puts a region of size bytes which render fills in, either right away or,
+    // when the image is rendered in parallel, later on a worker thread
+    void region(size_t size, const std::function<void(Byte *)>& render) const;
+    // the file offset of an rva in the .text section
+    size_t TextOffset(size_t rva) const;
+    // feeds freshly rendered bytes of the image to the strong name hash
+    void HashImage(size_t offset, size_t len) const;
 private:
-    std::iostream *outputFile_;
+    // the image being rendered and the current position in it
+    Byte *image_;
+    mutable size_t pos_;
+    // the strong name hash, computed while the image is rendered, and the
+    // file ranges which are left out of it
+    SHA1Context *hash_;
+    size_t unhashed_[2][2];
+    // regions waiting for the worker threads, null for sequential rendering
+    typedef std::vector<std::pair<size_t, std::function<void(Byte *)> > > Jobs;
+    Jobs *jobs_;
+    unsigned workers_;
+    size_t methodsEnd_;
+    // the managed resources, the .mresources data is streamed from them while rendering
+    struct ManifestResource
+    {
+        std::string path;
+        const Byte *data;
+        size_t size;
+    };
+    std::vector<ManifestResource> resources_;
+    size_t AddManifestResource(const std::string& name, DWord flags, const ManifestResource& resource);
+    size_t resourcesSize_;
+    // set when a resource file could not be read completely
+    mutable std::atomic<bool> incomplete_;
     std::string snkFile_;
-    // a reflection of the String stream so that we can keep from doing duplicates.
-    // right now we don't check duplicates on any of the other streams...
-    std::map<std::string, size_t> stringMap_;
+    // the tables ECMA-335 wants sorted by their primary key
+    static const int sortedTables_[];
+    void MergeStringSuffixes();
+    void SortTables();
+    template <class Char> size_t HashUS(const Char* str, int len);
+    // a heap is a list of segments which never move once allocated, so growing it
+    // copies nothing. An entry never straddles two segments and offsets count the
+    // used bytes of the segments in order, so the heap is their concatenation
     struct pool
     {
-        pool() : size(0), maxSize(200), base(nullptr) { base = (Byte *)calloc(1, maxSize); }
-        ~pool() { free(base); }
+        pool() : size(0), added(0), shared(0), used(0) { }
+        ~pool();
         size_t size;
-        size_t maxSize;
-        Byte *base;
+        // make room for newSize contiguous bytes at Tail(), in a new segment if needed
         void Ensure(size_t newSize);
+        Byte *Tail() const { return segments.back().base + segments.back().used; }
+        // append len bytes previously written at Tail()
+        void Commit(size_t len) { segments.back().used += len; size += len; }
+        Byte *At(size_t offset) const;
+        // copy the bytes from offset on
+        void CopyTo(Byte *dest, size_t offset = 0) const;
+        // start out as a copy of baseline, index included
+        void Continue(const pool &baseline);
+        // the len bytes at data are looked up by content; returns the offset of an
+        // identical entry, or appends them and returns theirs. data may be staged at
+        // Tail(), in which case nothing is copied
+        size_t Intern(const Byte* data, size_t len, size_t hash);
+        size_t Intern(size_t len) { return Intern(Tail(), len, HashBytes(Tail(), len)); }
+        // Intern calls, and how many of them found the entry in the heap
+        size_t added, shared;
+        static size_t HashBytes(const Byte* data, size_t len);
+        struct segment
+        {
+            Byte *base;
+            size_t start;
+            size_t used;
+            size_t capacity;
+        };
+        std::vector<segment> segments;
+        // open addressing index of the entries committed by Intern
+        struct slot
+        {
+            size_t offset;
+            size_t len;
+            size_t hash;
+        };
+        std::vector<slot> index;
+        size_t used;
+    };
+    // the rows of each table live by value in a deque of their own type, which
+    // grows in chunks without moving them; tables_ lists them in order.
+    // Render packs all rows of the table with the widths of the schema,
+    // calling the entry's encoder directly rather than through the vtable
+    struct TableRowsBase
+    {
+        virtual ~TableRowsBase() { }
+        virtual void Render(const MetaSchema &schema, Byte *dest) const = 0;
+        // put the rows in the given order and list them in table again
+        virtual void Reorder(const std::vector<size_t> &order, DNLTable &table) = 0;
     };
+    template <class Entry> struct TableRows : TableRowsBase
+    {
+        std::deque<Entry> rows;
+        virtual void Render(const MetaSchema &schema, Byte *dest) const override
+        {
+            for (const Entry &row : rows)
+                dest += row.Entry::Render(schema, dest);
+        }
+        virtual void Reorder(const std::vector<size_t> &order, DNLTable &table) override
+        {
+            std::deque<Entry> sorted;
+            for (auto i : order)
+                sorted.push_back(rows[i]);
+            rows.swap(sorted);
+            table.clear();
+            for (Entry &row : rows)
+                table.push_back(&row);
+        }
+    };
+    std::unique_ptr<TableRowsBase> rows_[MaxTables];
+    // the table and columns of an interned row
+    struct RowKey
+    {
+        int table;
+        ulonglong columns[4];
+        bool operator==(const RowKey &other) const
+        {
+            return table == other.table && !memcmp(columns, other.columns, sizeof(columns));
+        }
+    };
+    struct RowKeyHash
+    {
+        size_t operator()(const RowKey &key) const
+        {
+            ulonglong hash = key.table;
+            for (auto column : key.columns)
+                hash = (hash ^ column) * 0x100000001b3ULL;
+            return (size_t)(hash ^ (hash >> 32));
+        }
+    };
+    static RowKey Key(const TypeRefTableEntry &entry);
+    static RowKey Key(const MemberRefTableEntry &entry);
+    static RowKey Key(const TypeSpecTableEntry &entry);
+    static RowKey Key(const AssemblyRefTableEntry &entry);
+    static RowKey Key(const StandaloneSigTableEntry &entry);
+    static RowKey Key(const ModuleRefTableEntry &entry);
+    static RowKey Key(const MethodSpecTableEntry &entry);
+    template <class Entry> size_t InternTableEntry(const Entry &entry);
+    // copy the interned rows of a table of baseline, for Continue
+    template <class Entry> void ContinueTable(const PEWriter &baseline, int table);
+    std::unordered_map<RowKey, size_t, RowKeyHash> internedRows_;
+    // the offsets at which Continue started the #Strings, #US, #Blob and #GUID heaps of a delta
+    size_t deltaHeaps_[4];
     DNLTable tables_[MaxTables];
     size_t entryPoint_;
     std::list<PEMethod *> methods_;
@@ -152,6 +380,8 @@ private:
     size_t objectAlign_;
     size_t imageBase_;
     DWord language_;
+    bool pe32Plus_;
+    bool compactStrings_;
     Word assemblyVersion_[4];
     Word fileVersion_[4];
     Word productVersion_[4];
@@ -161,6 +391,7 @@ private:
     struct DotNetMetaTablesHeader *tablesHeader_;
     size_t streamHeaders_[5][2];
     size_t snkLen_;
+    size_t mvidIndex_;
     unsigned peBase_;
     unsigned corBase_;
     unsigned snkBase_;
@@ -205,12 +436,23 @@ public:
     size_t signatureToken_;
     size_t rva_;
     size_t methodDef_;
-    size_t Write(size_t sizes[MaxTables + ExtraIndexes], std::iostream &out) const;
+    // renders the method body to out, returns the number of bytes written
+    size_t Write(const size_t sizes[MaxTables + ExtraIndexes], Byte *out) const;
 private:
     PEMethod( const PEMethod& rhs );
     PEMethod& operator=( const PEMethod& rhs );
 };
 
+// a module which was written, with the writer that wrote it, so that later
+// generations of the module can be written as deltas against it
+class PEBaseline
+{
+public:
+    PEBaseline(PEWriter *writer, const std::string& moduleName) : writer_(writer), moduleName_(moduleName) { }
+    std::unique_ptr<PEWriter> writer_;
+    std::string moduleName_;
+};
+
 }
 #endif // PEWRITER_H
 
@@ -43,8 +43,11 @@
 
 #define PE_ORDINAL_FLAG    0x80000000
 #define PE_INTEL386        0x014c
+#define PE_AMD64           0x8664
 #define PE_MAGICNUM        0x010b
+#define PE_MAGICNUM_PLUS   0x020b
 #define PE_FILE_EXECUTABLE 0x0002
+#define PE_FILE_LARGE_ADDRESS_AWARE 0x0020
 #define PE_FILE_32BIT      0x0100
 #define PE_FILE_LIBRARY    0x2000
 #define PE_FILE_REVERSE_BITS_HIGH 0x8000
@@ -179,6 +182,78 @@ typedef long long longlong;
         int res3_rva, res3_size;
     };
 
+    // the PE32+ variant, no data_base and 64 bit image base and stack/heap sizes
+    struct PEHeader64
+    {
+        int signature;
+        short cpu_type;
+        short num_objects;
+        int time;
+        int symbol_ptr;
+        int num_symbols;
+        short nt_hdr_size;
+        short flags;
+        short magic;
+        unsigned char linker_major_version;
+        unsigned char linker_minor_version;
+        int code_size;
+        int data_size;
+        int bss_size;
+        int entry_point;
+        int code_base;
+        longlong image_base;
+        int object_align;
+        int file_align;
+        short os_major_version;
+        short os_minor_version;
+        short user_major_version;
+        short user_minor_version;
+        short subsys_major_version;
+        short subsys_minor_version;
+        int uu_1;
+        int image_size;
+        int header_size;
+        int chekcsum;
+        short subsystem;
+        short dll_flags;
+        longlong stack_size;
+        longlong stack_commit;
+        longlong heap_size;
+        longlong heap_commit;
+        int loader_flags;
+        int num_rvas;
+        // the data directories are the same as in PEHeader
+        int export_rva;
+        int export_size;
+        int import_rva;
+        int import_size;
+        int resource_rva;
+        int resource_size;
+        int exception_rva;
+        int exception_size;
+        int security_rva;
+        int security_size;
+        int fixup_rva;
+        int fixup_size;
+        int debug_rva;
+        int debug_size;
+        int desc_rva;
+        int desc_size;
+        int mspec_rva;
+        int mspec_size;
+        int tls_rva;
+        int tls_size;
+        int loadconfig_rva;
+        int loadconfig_size;
+        int boundimp_rva;
+        int boundimp_size;
+        int iat_rva;
+        int iat_size;
+        int delay_imports_rva, delay_imports_size;
+        int com_rva, com_size;
+        int res3_rva, res3_size;
+    };
+
 #ifndef PEHEADER_ONLY
     struct PEObject
     {
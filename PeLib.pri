@@ -53,6 +53,7 @@ SOURCES += \
     $$PWD/Class.cpp \
     $$PWD/CodeContainer.cpp \
     $$PWD/CreateGUID.cpp \
+    $$PWD/MappedFile.cpp \
     $$PWD/CustomAttributeContainer.cpp \
     $$PWD/DataContainer.cpp \
     $$PWD/Enum.cpp \
@@ -175,23 +175,16 @@ bool Property::PEDump(Stream& peLib)
     size_t propertyIndex = peLib.PEOut().NextTableIndex(tProperty);
     size_t nameIndex = peLib.PEOut().HashString(name_);
     size_t sz;
-    Byte* sig = SignatureGenerator::PropertySig(this, sz);
+    SignatureGenerator generator;
+    Byte* sig = generator.PropertySig(this, sz);
     size_t propertySignature = peLib.PEOut().HashBlob(sig, sz);
-    delete[] sig;
-    TableEntryBase* table = new PropertyTableEntry(flags_, nameIndex, propertySignature);
-    peLib.PEOut().AddTableEntry(table);
+    peLib.PEOut().AddTableEntry(PropertyTableEntry(flags_, nameIndex, propertySignature));
 
     Semantics semantics = Semantics(Semantics::Property, propertyIndex);
-    // FIXME : Coverity complains that the following 'new' statements leak memory, however, I think
-    // the design is that the related constructors have side effects and the whole point of the new is to invoke those
-    // however, this is an awkard design that is hard to maintain and should probably be reworked.
-
-    table = new MethodSemanticsTableEntry(MethodSemanticsTableEntry::Getter, getter_->Signature()->PEIndex(), semantics);
-    peLib.PEOut().AddTableEntry(table);
+    peLib.PEOut().AddTableEntry(MethodSemanticsTableEntry(MethodSemanticsTableEntry::Getter, getter_->Signature()->PEIndex(), semantics));
     if (setter_)
     {
-        table = new MethodSemanticsTableEntry(MethodSemanticsTableEntry::Setter, setter_->Signature()->PEIndex(), semantics);
-        peLib.PEOut().AddTableEntry(table);
+        peLib.PEOut().AddTableEntry(MethodSemanticsTableEntry(MethodSemanticsTableEntry::Setter, setter_->Signature()->PEIndex(), semantics));
     }
     return true;
 }
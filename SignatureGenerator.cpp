@@ -34,12 +34,11 @@
 #include "Method.h"
 #include "PEMetaTables.h"
 #include <cassert>
+#include <cstring>
 
 namespace DotNetPELib
 {
-int SignatureGenerator::workArea[400 * 1024];
-
-int SignatureGenerator::basicTypes[] = {0,
+const int SignatureGenerator::basicTypes[] = {0,
                                         0,
                                         0,
                                         0,
@@ -61,38 +60,35 @@ int SignatureGenerator::basicTypes[] = {0,
                                         0,
                                         ELEMENT_TYPE_STRING};
 
-int SignatureGenerator::objectBase;
-
-size_t SignatureGenerator::EmbedType(int* buf, int offset, Type* tp)
+void SignatureGenerator::EmbedType(Type* tp)
 {
-    int rv = 0;
     if( tp->Modopt() && tp->Modopt()->GetBasicType() == Type::ClassRef )
     {
         // ELEMENT_TYPE_CMOD_OPT (typeRef)
         // to realize modopt([mscorlib]System.Runtime.CompilerServices.CallConvCdecl)
         // placed on the return type of the delegates Invoke signature
-        buf[offset + rv++] = ELEMENT_TYPE_CMOD_OPT;
+        Put(ELEMENT_TYPE_CMOD_OPT);
         Class* cls = static_cast<Class*>(tp->Modopt()->GetClass());
         assert(cls);
         // cannot use EmbedType here becode it would add ELEMENT_TYPE_CLASS
         if( cls->PEIndex() == 0 )
             std::cerr << "SignatureGenerator::EmbedType classRef with no PEIndex" << std::endl;
         if (cls->InAssemblyRef())
-            buf[offset + rv++] = (cls->PEIndex() << 2) | TypeDefOrRef::TypeRef;
+            Put((cls->PEIndex() << 2) | TypeDefOrRef::TypeRef);
         else
-            buf[offset + rv++] = (cls->PEIndex() << 2) | TypeDefOrRef::TypeDef;
+            Put((cls->PEIndex() << 2) | TypeDefOrRef::TypeDef);
     }
 
     if (tp->Pinned())
-        buf[offset + rv++] = ELEMENT_TYPE_PINNED;
+        Put(ELEMENT_TYPE_PINNED);
 
     if (tp->ByRef())
-        buf[offset + rv++] = ELEMENT_TYPE_BYREF;
+        Put(ELEMENT_TYPE_BYREF);
 
 #if 0
     // when this is here instead of below we get a "type[]*" if tp has both pointer and array level.
     for (int i = 0; i < tp->PointerLevel(); i++)
-        buf[offset + rv++] = ELEMENT_TYPE_PTR;
+        Put(ELEMENT_TYPE_PTR);
 #endif
 
     if (tp->ArrayLevel())
@@ -100,36 +96,36 @@ size_t SignatureGenerator::EmbedType(int* buf, int offset, Type* tp)
 #if 0
         if (tp->ArrayLevel() == 1)
         {
-            buf[offset + rv++] = ELEMENT_TYPE_SZARRAY;
+            Put(ELEMENT_TYPE_SZARRAY);
         }
         else
         {
-            buf[offset + rv++] = ELEMENT_TYPE_ARRAY;
+            Put(ELEMENT_TYPE_ARRAY);
         }
 #else
         for( int i = 0; i < tp->ArrayLevel(); i++ )
-            buf[offset + rv++] = ELEMENT_TYPE_SZARRAY;
+            Put(ELEMENT_TYPE_SZARRAY);
 #endif
     }
 
 #if 1
     // with this order we get a "type*[]" if tp has both pointer and array level.
     for (int i = 0; i < tp->PointerLevel(); i++)
-        buf[offset + rv++] = ELEMENT_TYPE_PTR;
+        Put(ELEMENT_TYPE_PTR);
 #endif
 
     switch (tp->GetBasicType())
     {
         case Type::object:
-            buf[offset + rv++] = ELEMENT_TYPE_OBJECT;
+            Put(ELEMENT_TYPE_OBJECT);
             break;
         case Type::MethodParam:
-            buf[offset + rv++] = ELEMENT_TYPE_MVAR;
-            buf[offset + rv++] = tp->VarNum();
+            Put(ELEMENT_TYPE_MVAR);
+            Put(tp->VarNum());
             break;
         case Type::TypeVar:
-            buf[offset + rv++] = ELEMENT_TYPE_VAR;
-            buf[offset + rv++] = tp->VarNum();
+            Put(ELEMENT_TYPE_VAR);
+            Put(tp->VarNum());
             break;
         case Type::ClassRef:
         {
@@ -137,34 +133,34 @@ size_t SignatureGenerator::EmbedType(int* buf, int offset, Type* tp)
             Class* cls1 = cls;
             if (cls->Generic().size())
             {
-                buf[offset + rv++] = ELEMENT_TYPE_GENERICINST;
+                Put(ELEMENT_TYPE_GENERICINST);
                 // the parent is expected to be the main class for the generic.
                 cls1 = cls->GenericParent();
             }
             if (cls1->Flags().Flags() & Qualifiers::Value)
             {
-                buf[offset + rv++] = ELEMENT_TYPE_VALUETYPE;
+                Put(ELEMENT_TYPE_VALUETYPE);
             }
             else
             {
-                buf[offset + rv++] = ELEMENT_TYPE_CLASS;
+                Put(ELEMENT_TYPE_CLASS);
             }
             if( cls1->PEIndex() == 0 )
                 std::cerr << "SignatureGenerator::EmbedType classRef with no PEIndex" << std::endl;
             if (cls1->InAssemblyRef())
             {
-                buf[offset + rv++] = (cls1->PEIndex() << 2) | TypeDefOrRef::TypeRef;
+                Put((cls1->PEIndex() << 2) | TypeDefOrRef::TypeRef);
             }
             else
             {
-                buf[offset + rv++] = (cls1->PEIndex() << 2) | TypeDefOrRef::TypeDef;
+                Put((cls1->PEIndex() << 2) | TypeDefOrRef::TypeDef);
             }
             if (cls->Generic().size())
             {
-                buf[offset + rv++] = cls->Generic().size();
+                Put(cls->Generic().size());
                 for (auto type : cls->Generic())
                 {
-                    rv += EmbedType(buf, offset + rv, type);
+                    EmbedType(type);
                 }
             }
             break;
@@ -172,14 +168,14 @@ size_t SignatureGenerator::EmbedType(int* buf, int offset, Type* tp)
         case Type::MethodRef:
         {
             MethodSignature* sig = tp->GetMethod();
-            buf[offset + rv++] = ELEMENT_TYPE_FNPTR;
-            rv += CoreMethod(sig, sig->ParamCount() + sig->VarargParamCount(), buf, offset + rv);
+            Put(ELEMENT_TYPE_FNPTR);
+            CoreMethod(sig, sig->ParamCount() + sig->VarargParamCount());
             if (sig->VarargParamCount())
             {
-                workArea[offset + rv++] = ELEMENT_TYPE_SENTINEL;
+                Put(ELEMENT_TYPE_SENTINEL);
                 for (MethodSignature::viterator it = sig->vbegin(); it != sig->vend(); ++it)
                 {
-                    rv += EmbedType(workArea, offset + rv, (*it)->GetType());
+                    EmbedType((*it)->GetType());
                 }
             }
         }
@@ -187,26 +183,25 @@ size_t SignatureGenerator::EmbedType(int* buf, int offset, Type* tp)
         case Type::Void:
             if (tp->PEIndex())
             {
-                buf[offset + rv++] = ELEMENT_TYPE_CLASS;
-                buf[offset + rv++] = (tp->PEIndex() << 2) | TypeDefOrRef::TypeRef;
+                Put(ELEMENT_TYPE_CLASS);
+                Put((tp->PEIndex() << 2) | TypeDefOrRef::TypeRef);
                 break;
             }
             // fall through
         default:
-            buf[offset + rv++] = basicTypes[tp->GetBasicType()];
+            Put(basicTypes[tp->GetBasicType()]);
             break;
     }
 #if 0 // we only support SZARRAY of SZARRAY, not ARRAY
     if (tp->ArrayLevel() > 1)
     {
-        buf[offset + rv++] = tp->ArrayLevel();  // rank
-        buf[offset + rv++] = 0;                 // sizes = unsized
-        buf[offset + rv++] = tp->ArrayLevel();  // lower bounds, set all to always zero for this
+        Put(tp->ArrayLevel();  // rank
+        Put(0;                 // sizes = unsized
+        Put(tp->ArrayLevel();  // lower bounds, set all to always zero for this
         for (int i = 0; i < tp->ArrayLevel(); i++)
-            buf[offset + rv++] = 0;
+            Put(0);
     }
 #endif
-    return rv;
 }
 size_t SignatureGenerator::LoadIndex(Byte* buf, size_t& start, size_t& len)
 {
@@ -232,45 +227,48 @@ size_t SignatureGenerator::LoadIndex(Byte* buf, size_t& start, size_t& len)
     }
 }
 
-Byte* SignatureGenerator::ConvertToBlob(int* buf, int size, size_t& sz)
+void SignatureGenerator::Put(int value)
 {
-    sz = 0;
-    for (int i = 0; i < size; i++)
+    if (size_ + 4 > capacity_)
+        Grow();
+    Byte* p = data_ + size_;
+    // most values are element types and small indexes, so test for one byte first
+    if (value <= 0x7f)
     {
-        if (buf[i] > 0x3fff)
-            sz += 4;
-        else if (buf[i] > 0x7f)
-            sz += 2;
-        else
-            sz += 1;
+        p[0] = value;
+        size_ += 1;
     }
-    Byte* rv = new Byte[sz];
-    int pos = 0;
-    for (int i = 0; i < size; i++)
+    else if (value <= 0x3fff)
     {
-        if (buf[i] > 0x3fff)
-        {
-            rv[pos++] = ((buf[i] >> 24) & 0x1f) | 0xc0;
-            rv[pos++] = (buf[i] >> 16) & 0xff;
-            rv[pos++] = (buf[i] >> 8) & 0xff;
-            rv[pos++] = buf[i] & 0xff;
-        }
-        else if (buf[i] > 0x7f)
-        {
-            rv[pos++] = (buf[i] >> 8) | 0x80;
-            rv[pos++] = buf[i] & 0xff;
-        }
-        else
-        {
-            rv[pos++] = buf[i];
-        }
+        p[0] = (value >> 8) | 0x80;
+        p[1] = value & 0xff;
+        size_ += 2;
     }
-    return rv;
+    else
+    {
+        p[0] = ((value >> 24) & 0x1f) | 0xc0;
+        p[1] = (value >> 16) & 0xff;
+        p[2] = (value >> 8) & 0xff;
+        p[3] = value & 0xff;
+        size_ += 4;
+    }
+}
+void SignatureGenerator::Grow()
+{
+    std::vector<Byte> larger(capacity_ * 2);
+    memcpy(&larger[0], data_, size_);
+    heap_.swap(larger);
+    data_ = &heap_[0];
+    capacity_ = heap_.size();
+}
+Byte* SignatureGenerator::Result(size_t& sz)
+{
+    sz = size_;
+    size_ = 0;
+    return data_;
 }
-size_t SignatureGenerator::CoreMethod(MethodSignature* method, int paramCount, int* buf, int offset)
+void SignatureGenerator::CoreMethod(MethodSignature* method, int paramCount)
 {
-    int origOffset = offset;
-    int size = offset;
     int flag = 0;
     // for static members, flag will usually remain 0
     if (method->Flags() & MethodSignature::InstanceFlag)
@@ -279,97 +277,86 @@ size_t SignatureGenerator::CoreMethod(MethodSignature* method, int paramCount, i
         flag |= 5;
     if (method->GenericParamCount())
         flag |= 0x10;
-    workArea[size++] = flag;
+    Put(flag);
     if (method->GenericParamCount())
     {
-        workArea[size++] = method->GenericParamCount();
+        Put(method->GenericParamCount());
     }
-    workArea[size++] = paramCount;
-    size += EmbedType(workArea, size, method->ReturnType());
+    Put(paramCount);
+    EmbedType(method->ReturnType());
     for (auto it = method->begin(); it != method->end(); ++it)
     {
-        size += EmbedType(workArea, size, (*it)->GetType());
+        EmbedType((*it)->GetType());
     }
-    return size - origOffset;
 }
 Byte* SignatureGenerator::MethodDefSig(MethodSignature* method, size_t& sz)
 {
-    int size = 0;
-    size = CoreMethod(method, method->ParamCount(), workArea, 0);
-    return ConvertToBlob(workArea, size, sz);
+    CoreMethod(method, method->ParamCount());
+    return Result(sz);
 }
 Byte* SignatureGenerator::MethodRefSig(MethodSignature* method, size_t& sz)
 {
-    int size = 0;
-    size = CoreMethod(method, method->ParamCount() + method->VarargParamCount(), workArea, 0);
+    CoreMethod(method, method->ParamCount() + method->VarargParamCount());
     // variable length args... this is the difference from the methoddef
     if ((method->Flags() & MethodSignature::Vararg) && !(method->Flags() & MethodSignature::Managed))
     {
         if (method->VarargParamCount())
         {
-            workArea[size++] = ELEMENT_TYPE_SENTINEL;
+            Put(ELEMENT_TYPE_SENTINEL);
             for (MethodSignature::viterator it = method->vbegin(); it != method->vend(); ++it)
             {
-                size += EmbedType(workArea, size, (*it)->GetType());
+                EmbedType((*it)->GetType());
             }
         }
     }
-    return ConvertToBlob(workArea, size, sz);
+    return Result(sz);
 }
 Byte *SignatureGenerator::MethodSpecSig(MethodSignature *signature, size_t &sz)
 {
-    int size = 0;
-    workArea[size++] = 0x0a; // generic
-    workArea[size++] = signature->Generic().size();
+    Put(0x0a); // generic
+    Put(signature->Generic().size());
     for (auto g : signature->Generic())
     {
-       size += EmbedType(workArea, size, g);
+       EmbedType(g);
     }
-    return ConvertToBlob(workArea, size, sz);
+    return Result(sz);
 }
 
 Byte* SignatureGenerator::FieldSig(Field* field, size_t& sz)
 {
-    int size = 0;
-    workArea[size++] = 6;  // field sig
+    Put(6);  // field sig
     // here we would put the
-    size += EmbedType(workArea, size, field->FieldType());
-    return ConvertToBlob(workArea, size, sz);
+    EmbedType(field->FieldType());
+    return Result(sz);
 }
 Byte* SignatureGenerator::PropertySig(Property* property, size_t& sz)
 {
-    int size = 0;
-    // a property sig is a modification of the methoddef of the getter
-    workArea[size++] = 8;
-
-    size = CoreMethod(property->Getter()->Signature(), property->Getter()->Signature()->ParamCount(), workArea, 0);
-    // set the instance flag based on whether the property is a static or nonstatic member
-    if (property->Instance())
-    {
-        workArea[1] |= 0x20;
-    }
-    else
+    // a property sig is the methoddef sig of the getter with PROPERTY in place of the
+    // calling convention, and the instance flag telling whether the property is static
+    MethodSignature* getter = property->Getter()->Signature();
+    Put(property->Instance() ? 0x28 : 0x08);
+    Put(getter->ParamCount());
+    EmbedType(getter->ReturnType());
+    for (auto it = getter->begin(); it != getter->end(); ++it)
     {
-        workArea[1] &= ~0x20;
+        EmbedType((*it)->GetType());
     }
-    return ConvertToBlob(workArea, size, sz);
+    return Result(sz);
 }
 Byte* SignatureGenerator::LocalVarSig(Method* method, size_t& sz)
 {
-    int size = 0;
-    workArea[size++] = 7;  // locals sig
-    workArea[size++] = method->size();
+    Put(7);  // locals sig
+    Put(method->size());
     for (auto it = method->begin(); it != method->end(); ++it)
     {
-        size += EmbedType(workArea, size, (*it)->GetType());
+        EmbedType((*it)->GetType());
     }
-    return ConvertToBlob(workArea, size, sz);
+    return Result(sz);
 }
 Byte* SignatureGenerator::TypeSig(Type* type, size_t& sz)
 {
-    int size = 0;
-    size += EmbedType(workArea, size, type);
-    return ConvertToBlob(workArea, size, sz);
+    EmbedType(type);
+    return Result(sz);
 }
 
 
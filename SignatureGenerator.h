@@ -2,6 +2,7 @@
 #define SIGNATUREGENERATOR_H
 
 #include <stddef.h>
+#include <vector>
 
 namespace DotNetPELib {
 
@@ -17,35 +18,45 @@ class Type;
 // to put in the blob stream
 class SignatureGenerator
 {
-    // this implementation isn't completely thread safe - it uses the equivalent the
-    // equivalent of a global variable to keep track of state
+    // each generator builds its signatures in a buffer of its own, so signatures can
+    // be generated on several threads at once. The signatures are compressed as they
+    // are generated; the returned pointer stays valid until the same generator makes
+    // the next one or goes away
 public:
-    static Byte *MethodDefSig(MethodSignature *signature, size_t &sz);
-    static Byte *MethodRefSig(MethodSignature *signature, size_t &sz);
-    static Byte *MethodSpecSig(MethodSignature *signature, size_t &sz);
-    static Byte *PropertySig(Property *property, size_t &sz);
-    static Byte *FieldSig(Field *field, size_t &sz);
+    SignatureGenerator() : data_(inline_), size_(0), capacity_(sizeof(inline_)) { }
+    SignatureGenerator(const SignatureGenerator&) = delete;
+    SignatureGenerator& operator=(const SignatureGenerator&) = delete;
+
+    Byte *MethodDefSig(MethodSignature *signature, size_t &sz);
+    Byte *MethodRefSig(MethodSignature *signature, size_t &sz);
+    Byte *MethodSpecSig(MethodSignature *signature, size_t &sz);
+    Byte *PropertySig(Property *property, size_t &sz);
+    Byte *FieldSig(Field *field, size_t &sz);
     //Byte *PropertySig(Property *property);
-    static Byte *LocalVarSig(Method *method, size_t &sz);
-    static Byte *TypeSig(Type *type, size_t &sz);
+    Byte *LocalVarSig(Method *method, size_t &sz);
+    Byte *TypeSig(Type *type, size_t &sz);
 
     // end of signature generators, this function is a generic function to embed a type
     // inito a signature
-    static size_t EmbedType(int *buf, int offset, Type *tp);
-    // this function converts a signature buffer to a blob entry, by compressing
-    // the integer values in the signature
-    static Byte *ConvertToBlob(int *buf, int size, size_t &sz);
-
-    // this function sets the index for the 'object' class entry
-    static void SetObjectType(size_t ObjectBase) { objectBase = ObjectBase; }
+    void EmbedType(Type *tp);
 
 private:
     // a shared function for the various signatures that put in method signatures
-    static size_t CoreMethod(MethodSignature *method, int paramCount, int *buf, int offset);
+    void CoreMethod(MethodSignature *method, int paramCount);
     static size_t LoadIndex(Byte *buf, size_t &start, size_t &len);
-    static int workArea[400 * 1024];
-    static int basicTypes[];
-    static int objectBase;
+    // append a value as an ECMA-335 compressed integer
+    void Put(int value);
+    // double the room, the signature moves out of inline_ the first time
+    void Grow();
+    // hand out the signature and start the next one
+    Byte *Result(size_t &sz);
+    // most signatures are a few bytes long and never leave inline_
+    Byte inline_[64];
+    std::vector<Byte> heap_;
+    Byte *data_;
+    size_t size_;
+    size_t capacity_;
+    static const int basicTypes[];
 };
 }
 
@@ -199,11 +199,10 @@ size_t Type::Render(Stream& peLib, Byte* result)
                     if (!peIndex_)
                     {
                         size_t sz;
-                        Byte* sig = SignatureGenerator::TypeSig(this, sz);
+                        SignatureGenerator generator;
+                        Byte* sig = generator.TypeSig(this, sz);
                         size_t signature = peLib.PEOut().HashBlob(sig, sz);
-                        delete[] sig;
-                        TypeSpecTableEntry* table = new TypeSpecTableEntry(signature);
-                        peIndex_ = peLib.PEOut().AddTableEntry(table);
+                        peIndex_ = peLib.PEOut().AddTableEntry(TypeSpecTableEntry(signature));
                     }
                     *(int*)result = peIndex_ | (tTypeSpec << 24);
                 }
@@ -224,11 +223,10 @@ size_t Type::Render(Stream& peLib, Byte* result)
                 if (!peIndex_)
                 {
                     size_t sz;
-                    Byte* sig = SignatureGenerator::TypeSig(this, sz);
+                    SignatureGenerator generator;
+                    Byte* sig = generator.TypeSig(this, sz);
                     size_t signature = peLib.PEOut().HashBlob(sig, sz);
-                    delete[] sig;
-                    TypeSpecTableEntry* table = new TypeSpecTableEntry(signature);
-                    peIndex_ = peLib.PEOut().AddTableEntry(table);
+                    peIndex_ = peLib.PEOut().AddTableEntry(TypeSpecTableEntry(signature));
                 }
                 *(int*)result = peIndex_ | (tTypeSpec << 24);
             }
@@ -248,11 +246,10 @@ size_t Type::Render(Stream& peLib, Byte* result)
                 // if rendering a method as a type we are always going to put the sig
                 // in the type spec table
                 size_t sz;
-                Byte* sig = SignatureGenerator::TypeSig(this, sz);
+                SignatureGenerator generator;
+                Byte* sig = generator.TypeSig(this, sz);
                 size_t signature = peLib.PEOut().HashBlob(sig, sz);
-                delete[] sig;
-                TypeSpecTableEntry* table = new TypeSpecTableEntry(signature);
-                peIndex_ = peLib.PEOut().AddTableEntry(table);
+                peIndex_ = peLib.PEOut().AddTableEntry(TypeSpecTableEntry(signature));
             }
             *(int*)result = peIndex_ | (tTypeSpec << 24);
             return 4;
@@ -0,0 +1,1451 @@
+#include "PublicApi.h"
+#include "PEWriter.h"
+#include "SignatureGenerator.h"
+#include "sha1.h"
+#include <QtDebug>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace DotNetPELib;
+
+// checks of what PEWriter puts into the image, by reading it back
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        qCritical() << "FAILED:" << what;
+        failures++;
+    }
+}
+
+// the metadata of an image or of a delta: the streams, the table rows and the heaps
+class MetadataReader
+{
+public:
+    MetadataReader() : valid(false) { }
+    MetadataReader(const Byte* root, size_t size) : valid(false)
+    {
+        memset(rows, 0, sizeof(rows));
+        memset(sizes, 0, sizeof(sizes));
+        memset(tables, 0, sizeof(tables));
+        if (size < 16 || *(DWord*)root != 0x424A5342)
+            return;
+        const Byte* p = root + 16 + *(DWord*)(root + 12);
+        int count = *(Word*)(p + 2);
+        p += 4;
+        for (int i = 0; i < count; i++)
+        {
+            std::string name = (const char*)p + 8;
+            streams.push_back(Stream { name, root + *(DWord*)p, *(DWord*)(p + 4) });
+            p += 8 + ((name.size() + 1 + 3) & ~3);
+        }
+        const Stream* tableStream = Find("#~");
+        if (!tableStream)
+            tableStream = Find("#-");
+        if (!tableStream)
+            return;
+        valid = true;
+        p = tableStream->data;
+        heapSizes = p[6];
+        maskValid = *(ulonglong*)(p + 8);
+        maskSorted = *(ulonglong*)(p + 16);
+        p += 24;
+        for (int n = 0; n < MaxTables; n++)
+            if (maskValid & (1ULL << n))
+            {
+                rows[n] = *(DWord*)p;
+                p += 4;
+            }
+        // the delta flag makes every column four bytes wide
+        const bool wide = heapSizes & 0x20;
+        for (int n = 0; n < MaxTables; n++)
+            sizes[n] = wide ? 1 << 24 : rows[n];
+        sizes[tString] = wide || (heapSizes & 1) ? 1 << 24 : 0;
+        sizes[tGUID] = wide || (heapSizes & 2) ? 1 << 24 : 0;
+        sizes[tBlob] = wide || (heapSizes & 4) ? 1 << 24 : 0;
+        MetaSchema schema(sizes);
+        for (int n = 0; n < MaxTables; n++)
+        {
+            rowSize[n] = schema.rowSize[n];
+            tables[n] = p;
+            p += rows[n] * rowSize[n];
+        }
+    }
+    struct Stream
+    {
+        std::string name;
+        const Byte* data;
+        size_t size;
+    };
+    const Stream* Find(const std::string& name) const
+    {
+        for (auto&& stream : streams)
+            if (stream.name == name)
+                return &stream;
+        return nullptr;
+    }
+    // index counts from 1, as in a token
+    template <class Entry> Entry Row(int table, size_t index)
+    {
+        Entry entry;
+        entry.Get(sizes, const_cast<Byte*>(tables[table] + (index - 1) * rowSize[table]));
+        return entry;
+    }
+    std::string String(size_t offset) const { return (const char*)Find("#Strings")->data + offset; }
+    std::vector<Byte> Blob(size_t offset) const { return Heap("#Blob", offset); }
+    // a #US entry: the UTF-16 characters followed by the flag byte
+    std::vector<Byte> US(size_t offset) const { return Heap("#US", offset); }
+    std::vector<Byte> Heap(const char* name, size_t offset) const
+    {
+        const Byte* p = Find(name)->data + offset;
+        size_t len = *p++;
+        if ((len & 0xc0) == 0xc0)
+        {
+            len = ((len & 0x1f) << 24) + (p[0] << 16) + (p[1] << 8) + p[2];
+            p += 3;
+        }
+        else if (len & 0x80)
+            len = ((len & 0x3f) << 8) + *p++;
+        return std::vector<Byte>(p, p + len);
+    }
+    bool valid;
+    Byte heapSizes;
+    ulonglong maskValid, maskSorted;
+    size_t rows[MaxTables];
+    size_t sizes[MaxTables + ExtraIndexes];
+    size_t rowSize[MaxTables];
+    const Byte* tables[MaxTables];
+    std::vector<Stream> streams;
+};
+
+// the headers of a PE image and the metadata they lead to
+class ImageReader
+{
+public:
+    ImageReader(const std::vector<Byte>& image) : image(image), valid(false), pe32Plus(false), cor20(nullptr)
+    {
+        if (image.size() < 0x200 || image[0] != 'M' || image[1] != 'Z')
+            return;
+        const Byte* pe = &image[0] + *(DWord*)&image[0x3c];
+        if (memcmp(pe, "PE\0\0", 4))
+            return;
+        machine = *(Word*)(pe + 4);
+        int sections = *(Word*)(pe + 6);
+        timeStamp = *(DWord*)(pe + 8);
+        optional = pe + 24;
+        pe32Plus = *(Word*)optional == 0x20b;
+        imageBase = pe32Plus ? *(ulonglong*)(optional + 24) : *(DWord*)(optional + 28);
+        fileAlign = *(DWord*)(optional + 36);
+        sizeOfImage = *(DWord*)(optional + 56);
+        sizeOfHeaders = *(DWord*)(optional + 60);
+        directories = optional + (pe32Plus ? 112 : 96);
+        const Byte* section = optional + *(Word*)(pe + 20);
+        for (int i = 0; i < sections; i++, section += 40)
+            this->sections.push_back(Section { std::string((const char*)section, strnlen((const char*)section, 8)),
+                                               *(DWord*)(section + 8), *(DWord*)(section + 12),
+                                               *(DWord*)(section + 16), *(DWord*)(section + 20) });
+        cor20 = At(Directory(14));
+        if (!cor20)
+            return;
+        metadata = MetadataReader(At(*(DWord*)(cor20 + 8)), *(DWord*)(cor20 + 12));
+        valid = metadata.valid;
+    }
+    struct Section
+    {
+        std::string name;
+        DWord virtualSize, virtualAddress, rawSize, rawPointer;
+    };
+    DWord Directory(int n) const { return *(DWord*)(directories + 8 * n); }
+    DWord DirectorySize(int n) const { return *(DWord*)(directories + 8 * n + 4); }
+    const Byte* At(DWord rva) const
+    {
+        for (auto&& section : sections)
+            if (rva >= section.virtualAddress && rva < section.virtualAddress + section.rawSize)
+                return &image[0] + rva - section.virtualAddress + section.rawPointer;
+        return nullptr;
+    }
+    // the CLI header fields
+    DWord CorFlags() const { return *(DWord*)(cor20 + 16); }
+    DWord Resources() const { return *(DWord*)(cor20 + 24); }
+    DWord StrongNameSignature() const { return *(DWord*)(cor20 + 32); }
+    DWord StrongNameSignatureSize() const { return *(DWord*)(cor20 + 36); }
+    // the code bytes of the body at rva, tiny or fat
+    std::vector<Byte> Code(DWord rva) const
+    {
+        const Byte* body = At(rva);
+        if ((body[0] & 3) == 2)
+            return std::vector<Byte>(body + 1, body + 1 + (body[0] >> 2));
+        return std::vector<Byte>(body + 12, body + 12 + *(DWord*)(body + 4));
+    }
+    const std::vector<Byte>& image;
+    bool valid;
+    Word machine;
+    DWord timeStamp;
+    bool pe32Plus;
+    ulonglong imageBase;
+    DWord fileAlign, sizeOfImage, sizeOfHeaders;
+    const Byte* optional;
+    const Byte* directories;
+    const Byte* cor20;
+    std::vector<Section> sections;
+    MetadataReader metadata;
+};
+
+enum Options
+{
+    Deterministic = 1,
+    PE32Plus = 2,
+    CompactStrings = 4
+};
+
+static void SetOptions(PELib& peFile, int options)
+{
+    peFile.Deterministic(options & Deterministic);
+    peFile.PE32Plus(options & PE32Plus);
+    peFile.CompactStrings(options & CompactStrings);
+}
+
+static Class* SystemClass(PELib& peFile, const char* name)
+{
+    Resource* r;
+    peFile.MSCorLibAssembly();
+    peFile.Find("System", &r);
+    Class* cls = new Class(name, Qualifiers::Public, -1, -1);
+    static_cast<Namespace*>(r)->Add(cls);
+    return cls;
+}
+
+static MethodSignature* WriteLine(PELib& peFile)
+{
+    MethodSignature* sigWriteLine = new MethodSignature("WriteLine", MethodSignature::Managed, SystemClass(peFile, "Console"));
+    sigWriteLine->ReturnType(new Type(Type::Void));
+    sigWriteLine->AddParam(new Param("", new Type(Type::string)));
+    return sigWriteLine;
+}
+
+static Method* AddMain(PELib& peFile)
+{
+    AssemblyDef* assembly = peFile.WorkingAssembly();
+    MethodSignature* sigMain = new MethodSignature("$Main", MethodSignature::Managed, assembly);
+    sigMain->ReturnType(new Type(Type::Void));
+    Method* methMain = new Method(sigMain, Qualifiers::Private | Qualifiers::Static | Qualifiers::HideBySig |
+                                               Qualifiers::CIL | Qualifiers::Managed, true);
+    assembly->Add(methMain);
+    return methMain;
+}
+
+// the module of test2.cpp
+static void HiThere(PELib& peFile)
+{
+    Method* methMain = AddMain(peFile);
+    methMain->AddInstruction(new Instruction(Instruction::i_ldstr, new Operand("Hi there!", true)));
+    methMain->AddInstruction(new Instruction(Instruction::i_call, new Operand(new MethodName(WriteLine(peFile)))));
+    methMain->AddInstruction(new Instruction(Instruction::i_ret));
+}
+
+typedef void (*Module)(PELib&);
+
+static std::vector<Byte> Image(Module module, int options = 0, const char* name = "test3")
+{
+    PELib peFile(name, PELib::ilonly);
+    SetOptions(peFile, options);
+    module(peFile);
+    std::vector<Byte> image;
+    if (!peFile.DumpOutputImage(std::string(name) + ".exe", PELib::peexe, false, image))
+        image.clear();
+    return image;
+}
+
+static bool WriteOutput(Module module, const std::string& fileName, int options = 0, bool keepIdentical = false)
+{
+    PELib peFile("test3", PELib::ilonly);
+    SetOptions(peFile, options);
+    module(peFile);
+    return peFile.DumpOutputFile(fileName, PELib::peexe, false, keepIdentical);
+}
+
+static std::vector<Byte> ReadFile(const std::string& fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    return std::vector<Byte>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// the image is rendered into one buffer: headers, sections and metadata agree with each other
+void testSingleBuffer()
+{
+    std::vector<Byte> image = Image(HiThere);
+    ImageReader reader(image);
+    check(reader.valid, "image has a readable metadata root");
+    check(reader.sizeOfHeaders <= reader.sections.front().rawPointer, "headers end before the first section");
+    size_t end = 0;
+    for (auto&& section : reader.sections)
+    {
+        check(section.rawPointer % reader.fileAlign == 0, "section is aligned in the file");
+        end = std::max(end, (size_t)section.rawPointer + section.rawSize);
+    }
+    check(end == image.size(), "the last section ends the image");
+    check(reader.metadata.rows[tMethodDef] == 1, "one method");
+    MethodDefTableEntry main = reader.metadata.Row<MethodDefTableEntry>(tMethodDef, 1);
+    check(reader.metadata.String(main.nameIndex_.index_) == "$Main", "method name");
+    std::vector<Byte> code = reader.Code(main.rva_);
+    check(code.size() == 11 && code[0] == 0x72 && code[5] == 0x28 && code[10] == 0x2a, "method body");
+}
+
+// the mapped file holds the same bytes as the image rendered in memory
+void testMappedFile()
+{
+    check(WriteOutput(HiThere, "test3.exe", Deterministic), "mapped file is written");
+    std::vector<Byte> written = ReadFile("test3.exe");
+    check(!written.empty() && written == Image(HiThere, Deterministic), "mapped file matches the image");
+    check(!WriteOutput(HiThere, "no such directory/mapped.exe"), "a file that cannot be created is reported");
+}
+
+// a made up 512 bit key: the signature is compared with what RSAEncoder makes of the
+// expected hash, which takes the same key but not a valid one
+static void WriteKeyFile(const std::string& fileName)
+{
+    static const Byte header[] = { 0x07, 0x02, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 'R', 'S', 'A', '2' };
+    const DWord bits = 512, exponent = 0x10001;
+    std::ofstream out(fileName, std::ios::binary);
+    out.write((const char*)header, sizeof(header));
+    out.write((const char*)&bits, sizeof(bits));
+    out.write((const char*)&exponent, sizeof(exponent));
+    // the modulus, the primes and their exponents and the private exponent
+    for (DWord i = 0; i < bits / 8 + 5 * bits / 16 + bits / 8; i++)
+        out.put(char(i * 37 + 11));
+}
+
+// the signature covers the image but for the checksum, the certificate directory, the gap
+// after the object table and the signature itself
+void testStrongNameHash()
+{
+    WriteKeyFile("test3.snk");
+    std::vector<Byte> image = Image([](PELib& peFile) {
+        HiThere(peFile);
+        peFile.WorkingAssembly()->SNKFile("test3.snk");
+    });
+    ImageReader reader(image);
+    check(reader.valid && (reader.CorFlags() & 8), "image is strong name signed");
+    if (!reader.valid || !reader.StrongNameSignatureSize())
+        return;
+    std::vector<Byte> hashed(image);
+    size_t optional = reader.optional - &image[0];
+    memset(&hashed[optional + 64], 0, 4);
+    memset(&hashed[reader.directories - &image[0] + 4 * 8], 0, 8);
+    SHA1Context context;
+    SHA1Reset(&context);
+    SHA1Input(&context, &hashed[0], optional + *(Word*)(reader.optional - 4) + 40 * reader.sections.size());
+    const Byte* signature = reader.At(reader.StrongNameSignature());
+    for (auto&& section : reader.sections)
+    {
+        const Byte* begin = &hashed[section.rawPointer];
+        const Byte* end = begin + section.rawSize;
+        const Byte* hole = &hashed[signature - &image[0]];
+        if (hole >= begin && hole < end)
+        {
+            SHA1Input(&context, begin, hole - begin);
+            begin = hole + reader.StrongNameSignatureSize();
+        }
+        SHA1Input(&context, begin, end - begin);
+    }
+    SHA1Result(&context);
+    RSAEncoder encoder;
+    Byte expected[512];
+    size_t len = 0;
+    check(encoder.LoadStrongNameKeys("test3.snk") == 64, "key file loads");
+    encoder.GetStrongNameSignature(expected, &len, (const Byte*)context.Message_Digest, 20);
+    check(len == reader.StrongNameSignatureSize() && !memcmp(signature, expected, len),
+          "signature is made from the hash of the image");
+}
+
+// a few megabytes of methods, enough for the regions to be rendered by worker threads
+static void ManyMethods(PELib& peFile)
+{
+    AssemblyDef* assembly = peFile.WorkingAssembly();
+    for (int i = 0; i < 3000; i++)
+    {
+        MethodSignature* sig = new MethodSignature("m" + std::to_string(i), MethodSignature::Managed, assembly);
+        sig->ReturnType(new Type(Type::Void));
+        Method* method = new Method(sig, Qualifiers::Private | Qualifiers::Static | Qualifiers::HideBySig |
+                                             Qualifiers::CIL | Qualifiers::Managed, i == 0);
+        for (int j = 0; j < 200; j++)
+        {
+            method->AddInstruction(new Instruction(Instruction::i_ldc_i4, new Operand(i * 1000 + j, Operand::i32)));
+            method->AddInstruction(new Instruction(Instruction::i_pop));
+        }
+        method->AddInstruction(new Instruction(Instruction::i_ret));
+        assembly->Add(method);
+    }
+}
+
+// every body of a big image sits at its RVA, whichever thread rendered it
+void testParallelRegions()
+{
+    std::vector<Byte> image = Image(ManyMethods, Deterministic);
+    ImageReader reader(image);
+    check(reader.valid && image.size() > 3 * 1024 * 1024, "big image is written");
+    if (!reader.valid)
+        return;
+    int bad = 0;
+    for (size_t i = 1; i <= reader.metadata.rows[tMethodDef]; i++)
+    {
+        MethodDefTableEntry method = reader.metadata.Row<MethodDefTableEntry>(tMethodDef, i);
+        int n = atoi(reader.metadata.String(method.nameIndex_.index_).c_str() + 1);
+        std::vector<Byte> code = reader.Code(method.rva_);
+        if (code.size() != 200 * 6 + 1 || code[0] != 0x20 || *(int*)&code[1] != n * 1000 ||
+            *(int*)&code[199 * 6 + 1] != n * 1000 + 199 || code.back() != 0x2a)
+            bad++;
+    }
+    check(reader.metadata.rows[tMethodDef] == 3000 && !bad, "method bodies");
+    check(image == Image(ManyMethods, Deterministic), "the image renders the same again");
+}
+
+// a module whose resource file has gone missing cannot be rendered
+static void MissingResource(PELib& peFile)
+{
+    HiThere(peFile);
+    peFile.AddManifestResource("missing", "no such resource");
+}
+
+// with or without keepIdentical a module which cannot be rendered leaves the file as it was
+void testFailedOutput()
+{
+    std::vector<Byte> old = Image(HiThere);
+    for (int keepIdentical = 0; keepIdentical < 2; keepIdentical++)
+    {
+        std::ofstream("test3.exe", std::ios::binary).write((const char*)&old[0], old.size());
+        bool rv = true;
+        try
+        {
+            rv = WriteOutput(MissingResource, "test3.exe", 0, keepIdentical);
+        }
+        catch (PELibError&)
+        {
+            rv = false;
+        }
+        check(!rv, "failure is reported");
+        check(ReadFile("test3.exe") == old, keepIdentical ? "old file is kept with keepIdentical"
+                                                          : "old file is kept without keepIdentical");
+    }
+}
+
+// test2's module with another literal
+static void HiThereAgain(PELib& peFile)
+{
+    Method* methMain = AddMain(peFile);
+    methMain->AddInstruction(new Instruction(Instruction::i_ldstr, new Operand("Hi there again!", true)));
+    methMain->AddInstruction(new Instruction(Instruction::i_call, new Operand(new MethodName(WriteLine(peFile)))));
+    methMain->AddInstruction(new Instruction(Instruction::i_ret));
+}
+
+static std::vector<Byte> Mvid(ImageReader& reader)
+{
+    ModuleTableEntry module = reader.metadata.Row<ModuleTableEntry>(tModule, 1);
+    const Byte* guid = reader.metadata.Find("#GUID")->data + (module.guidIndex_.index_ - 1) * 16;
+    return std::vector<Byte>(guid, guid + 16);
+}
+
+// the same module gives the same bytes, the time stamp and the guid follow the contents
+void testDeterministic()
+{
+    std::vector<Byte> image = Image(HiThere, Deterministic);
+    check(!image.empty() && image == Image(HiThere, Deterministic), "identical input gives identical images");
+    std::vector<Byte> other = Image(HiThereAgain, Deterministic);
+    ImageReader reader(image), otherReader(other);
+    if (!reader.valid || !otherReader.valid)
+    {
+        check(false, "deterministic images are readable");
+        return;
+    }
+    check(reader.timeStamp & 0x80000000, "time stamp is marked as a hash");
+    std::vector<Byte> mvid = Mvid(reader);
+    check(mvid != std::vector<Byte>(16, 0) && (mvid[7] & 0xf0) == 0x40 && (mvid[9] & 0xc0) == 0x80,
+          "module guid has the version bits");
+    check(reader.timeStamp != otherReader.timeStamp, "another literal gives another time stamp");
+    check(mvid != Mvid(otherReader), "another literal gives another module guid");
+}
+
+// an identical file keeps its time stamp, a changed one is replaced without
+// touching the files next to it
+void testKeepIdentical()
+{
+    std::vector<Byte> image = Image(HiThere, Deterministic);
+    std::ofstream("test3.exe", std::ios::binary).write((const char*)&image[0], image.size());
+    std::ofstream("test3.exe.tmp") << "not ours";
+    struct utimbuf old = { 1000000000, 1000000000 };
+    utime("test3.exe", &old);
+    check(WriteOutput(HiThere, "test3.exe", Deterministic, true), "identical file is published");
+    struct stat st;
+    check(stat("test3.exe", &st) == 0 && st.st_mtime == old.modtime, "identical file keeps its time stamp");
+#ifndef _WIN32
+    chmod("test3.exe", 0640);
+#endif
+    check(WriteOutput(HiThereAgain, "test3.exe", Deterministic, true), "changed file is published");
+    check(ReadFile("test3.exe") == Image(HiThereAgain, Deterministic, "test3"), "changed file is replaced");
+    check(stat("test3.exe", &st) == 0 && st.st_mtime != old.modtime, "changed file gets a new time stamp");
+#ifndef _WIN32
+    check((st.st_mode & 0777) == 0640, "replaced file keeps its permissions");
+#endif
+    std::ifstream in("test3.exe.tmp");
+    std::string text;
+    std::getline(in, text);
+    check(text == "not ours", "a file named like the temporary one is left alone");
+}
+
+// the background write owns the image, so the PELib can be gone before it finishes
+void testAsyncOutput()
+{
+    std::future<bool> written[2];
+    {
+        PELib peFile("test3", PELib::ilonly);
+        SetOptions(peFile, Deterministic);
+        HiThere(peFile);
+        written[0] = peFile.DumpOutputFileAsync("test3.exe", PELib::peexe, false);
+    }
+    {
+        PELib peFile("async", PELib::ilonly);
+        SetOptions(peFile, Deterministic);
+        HiThere(peFile);
+        written[1] = peFile.DumpOutputFileAsync("async.exe", PELib::peexe, false, true);
+    }
+    check(written[0].get() && written[1].get(), "background writes succeed");
+    check(ReadFile("test3.exe") == Image(HiThere, Deterministic), "background write holds the image");
+    check(ReadFile("async.exe") == Image(HiThere, Deterministic, "async"), "background publish holds the image");
+}
+
+// a PE32+ image is for AMD64, has no entry stub to relocate and doesn't require 32 bits
+void testPE32Plus()
+{
+    std::vector<Byte> image = Image(HiThere, PE32Plus);
+    ImageReader reader(image);
+    check(reader.valid && reader.pe32Plus, "optional header is PE32+");
+    if (!reader.valid)
+        return;
+    check(reader.machine == 0x8664, "machine is AMD64");
+    check(reader.imageBase == 0x140000000ULL, "image base is above 4GB");
+    check(*(Word*)(reader.optional - 4) == 0xf0, "optional header size");
+    check(reader.sections.size() == 1 && reader.sections[0].name == ".text", "no .reloc section");
+    check(!reader.Directory(1) && !reader.Directory(5) && !reader.Directory(12), "no imports, relocations or IAT");
+    check(!(reader.CorFlags() & 2), "32 bits are not required");
+    std::vector<Byte> code = reader.Code(reader.metadata.Row<MethodDefTableEntry>(tMethodDef, 1).rva_);
+    check(code.size() == 11 && code[10] == 0x2a, "method body");
+}
+
+static const Byte resourceData[] = "resource from memory";
+
+static void Resources(PELib& peFile)
+{
+    HiThere(peFile);
+    peFile.AddManifestResource("memory", resourceData, sizeof(resourceData));
+    peFile.AddManifestResource("empty", nullptr, 0, false);
+    peFile.AddManifestResource("file", "test3.res");
+}
+
+// resources from memory and from files are laid out in .mresources in the order they were
+// added, and their contents go into the deterministic module guid
+void testResources()
+{
+    std::ofstream("test3.res", std::ios::binary) << "resource from a file";
+    std::vector<Byte> image = Image(Resources, Deterministic);
+    ImageReader reader(image);
+    check(reader.valid && reader.metadata.rows[tManifestResource] == 3, "three resources");
+    if (!reader.valid || reader.metadata.rows[tManifestResource] != 3)
+        return;
+    const Byte* resources = reader.At(reader.Resources());
+    const char* expected[] = { (const char*)resourceData, "", "resource from a file" };
+    size_t sizes[] = { sizeof(resourceData), 0, strlen(expected[2]) };
+    for (int i = 0; i < 3; i++)
+    {
+        ManifestResourceTableEntry row = reader.metadata.Row<ManifestResourceTableEntry>(tManifestResource, i + 1);
+        const Byte* resource = resources + row.offset_;
+        check(row.offset_ % 8 == 0, "resource is aligned");
+        check(*(DWord*)resource == sizes[i] && !memcmp(resource + 4, expected[i], sizes[i]), "resource contents");
+    }
+    check(reader.metadata.String(reader.metadata.Row<ManifestResourceTableEntry>(tManifestResource, 2).name_.index_)
+              == "empty", "resource name");
+    // same size, other contents
+    std::ofstream("test3.res", std::ios::binary) << "resource from A file";
+    std::vector<Byte> other = Image(Resources, Deterministic);
+    ImageReader otherReader(other);
+    check(otherReader.valid && Mvid(reader) != Mvid(otherReader), "resource contents go into the module guid");
+    bool rejected = false;
+    try
+    {
+        PELib peFile("test3", PELib::ilonly);
+        peFile.AddManifestResource("bad", nullptr, 10);
+        std::vector<Byte> image;
+        peFile.DumpOutputImage("test3.exe", PELib::peexe, false, image);
+    }
+    catch (PELibError&)
+    {
+        rejected = true;
+    }
+    check(rejected, "a resource without data is rejected");
+}
+
+static Method* AddStaticMethod(PELib& peFile, const std::string& name, Type* param = nullptr)
+{
+    AssemblyDef* assembly = peFile.WorkingAssembly();
+    MethodSignature* sig = new MethodSignature(name, MethodSignature::Managed, assembly);
+    sig->ReturnType(new Type(Type::Void));
+    if (param)
+        sig->AddParam(new Param("p", param));
+    Method* method = new Method(sig, Qualifiers::Private | Qualifiers::Static | Qualifiers::HideBySig |
+                                         Qualifiers::CIL | Qualifiers::Managed);
+    assembly->Add(method);
+    return method;
+}
+
+static void SameSignatures(PELib& peFile)
+{
+    HiThere(peFile);
+    AddStaticMethod(peFile, "a")->AddInstruction(new Instruction(Instruction::i_ret));
+    AddStaticMethod(peFile, "b")->AddInstruction(new Instruction(Instruction::i_ret));
+    AddStaticMethod(peFile, "c", new Type(Type::string))->AddInstruction(new Instruction(Instruction::i_ret));
+}
+
+// equal blobs are stored once
+void testBlobInterning()
+{
+    PEWriter writer(true, false, "");
+    Byte one[] = { 1, 2, 3 }, same[] = { 1, 2, 3 }, other[] = { 1, 2, 4 };
+    size_t index = writer.HashBlob(one, sizeof(one));
+    check(writer.HashBlob(same, sizeof(same)) == index, "equal blob is found");
+    check(writer.HashBlob(other, sizeof(other)) != index, "other blob is added");
+    check(writer.HashBlob(one, 2) != index, "prefix is added");
+
+    std::vector<Byte> image = Image(SameSignatures);
+    ImageReader reader(image);
+    check(reader.valid && reader.metadata.rows[tMethodDef] == 4, "four methods");
+    if (!reader.valid || reader.metadata.rows[tMethodDef] != 4)
+        return;
+    MethodDefTableEntry method[4];
+    for (int i = 0; i < 4; i++)
+        method[i] = reader.metadata.Row<MethodDefTableEntry>(tMethodDef, i + 1);
+    check(method[0].signatureIndex_.index_ == method[1].signatureIndex_.index_ &&
+              method[1].signatureIndex_.index_ == method[2].signatureIndex_.index_,
+          "methods with the same signature share its blob");
+    check(method[3].signatureIndex_.index_ != method[0].signatureIndex_.index_, "other signature has its own blob");
+    std::vector<Byte> sig = reader.metadata.Blob(method[3].signatureIndex_.index_);
+    check(sig.size() == 4 && sig[0] == 0 && sig[1] == 1 && sig[2] == 1 && sig[3] == 0x0e, "signature bytes");
+}
+
+static void SameLiterals(PELib& peFile)
+{
+    HiThere(peFile);
+    Method* method = AddStaticMethod(peFile, "again");
+    method->AddInstruction(new Instruction(Instruction::i_ldstr, new Operand("Hi there!", true)));
+    method->AddInstruction(new Instruction(Instruction::i_ldstr, new Operand("Hi there", true)));
+    method->AddInstruction(new Instruction(Instruction::i_pop));
+    method->AddInstruction(new Instruction(Instruction::i_pop));
+    method->AddInstruction(new Instruction(Instruction::i_ret));
+}
+
+// equal literals are stored once, whichever method loads them
+void testUSInterning()
+{
+    PEWriter writer(true, false, "");
+    const Word hi[] = { 'h', 'i' };
+    size_t index = writer.HashUS(hi, 2);
+    check(writer.HashUS(L"hi", 2) == index, "equal literal is found");
+    check(writer.HashUS("hi", 2) != index, "literal with a \\0 is another one");
+    check(writer.HashUS(hi, 1) != index, "prefix is added");
+
+    std::vector<Byte> image = Image(SameLiterals);
+    ImageReader reader(image);
+    check(reader.valid && reader.metadata.rows[tMethodDef] == 2, "two methods");
+    if (!reader.valid || reader.metadata.rows[tMethodDef] != 2)
+        return;
+    std::vector<Byte> main = reader.Code(reader.metadata.Row<MethodDefTableEntry>(tMethodDef, 1).rva_);
+    std::vector<Byte> again = reader.Code(reader.metadata.Row<MethodDefTableEntry>(tMethodDef, 2).rva_);
+    DWord token = *(DWord*)&main[1];
+    check((token >> 24) == 0x70 && *(DWord*)&again[1] == token, "equal literals share one #US entry");
+    check(*(DWord*)&again[6] != token, "other literal has its own entry");
+    std::vector<Byte> us = reader.metadata.US(token & 0xffffff);
+    // the literal carries a \0, and the flag byte follows
+    check(us.size() == 21 && us[0] == 'H' && us[1] == 0 && us[16] == '!' && us[18] == 0 && us[19] == 0,
+          "literal is UTF-16 with its flag");
+}
+
+// equal names are stored once
+void testStringInterning()
+{
+    PEWriter writer(true, false, "");
+    size_t index = writer.HashString("System");
+    check(writer.HashString(std::string("Sys") + "tem") == index, "equal name is found");
+    check(writer.HashString("System", PEWriter::StringHash("System")) == index, "name is found by its hash");
+    check(writer.HashString("Syste") != index && writer.HashString("System.IO") != index, "other names are added");
+
+    std::vector<Byte> image = Image([](PELib& peFile) {
+        HiThere(peFile);
+        AddStaticMethod(peFile, "System")->AddInstruction(new Instruction(Instruction::i_ret));
+    });
+    ImageReader reader(image);
+    check(reader.valid, "image is readable");
+    if (!reader.valid)
+        return;
+    const MetadataReader::Stream* strings = reader.metadata.Find("#Strings");
+    std::vector<std::string> names;
+    for (size_t offset = 1; offset < strings->size && strings->data[offset]; offset += names.back().size() + 1)
+        names.push_back((const char*)strings->data + offset);
+    std::sort(names.begin(), names.end());
+    check(!names.empty() && std::adjacent_find(names.begin(), names.end()) == names.end(), "no name is stored twice");
+    size_t system = 0;
+    for (size_t i = 1; i <= reader.metadata.rows[tTypeRef]; i++)
+    {
+        TypeRefTableEntry typeRef = reader.metadata.Row<TypeRefTableEntry>(tTypeRef, i);
+        if (reader.metadata.String(typeRef.typeNameSpaceIndex_.index_) == "System")
+            system = typeRef.typeNameSpaceIndex_.index_;
+    }
+    MethodDefTableEntry method = reader.metadata.Row<MethodDefTableEntry>(tMethodDef, 2);
+    check(system && method.nameIndex_.index_ == system, "method name and namespace share the name");
+}
+
+static void Suffixes(PELib& peFile)
+{
+    HiThere(peFile);
+    AddStaticMethod(peFile, "Line")->AddInstruction(new Instruction(Instruction::i_ret));
+    AddStaticMethod(peFile, "ne")->AddInstruction(new Instruction(Instruction::i_ret));
+}
+
+template <class Entry> static std::vector<std::string> Names(MetadataReader& metadata, int table,
+                                                           String Entry::*name)
+{
+    std::vector<std::string> names;
+    for (size_t i = 1; i <= metadata.rows[table]; i++)
+        names.push_back(metadata.String((metadata.Row<Entry>(table, i).*name).index_));
+    return names;
+}
+
+// names which are the tail of another name are stored inside it, and every row
+// still names what it did before
+void testStringSuffixes()
+{
+    std::vector<Byte> image = Image(Suffixes), compact = Image(Suffixes, CompactStrings);
+    ImageReader reader(image), compactReader(compact);
+    check(reader.valid && compactReader.valid, "images are readable");
+    if (!reader.valid || !compactReader.valid)
+        return;
+    MetadataReader &full = reader.metadata, &merged = compactReader.metadata;
+    check(merged.Find("#Strings")->size < full.Find("#Strings")->size, "heap gets smaller");
+    check(Names(full, tMethodDef, &MethodDefTableEntry::nameIndex_) ==
+              Names(merged, tMethodDef, &MethodDefTableEntry::nameIndex_) &&
+              Names(full, tMemberRef, &MemberRefTableEntry::nameIndex_) ==
+                  Names(merged, tMemberRef, &MemberRefTableEntry::nameIndex_) &&
+              Names(full, tTypeRef, &TypeRefTableEntry::typeNameIndex_) ==
+                  Names(merged, tTypeRef, &TypeRefTableEntry::typeNameIndex_),
+          "rows keep their names");
+    size_t writeLine = merged.Row<MemberRefTableEntry>(tMemberRef, 1).nameIndex_.index_;
+    size_t line = merged.Row<MethodDefTableEntry>(tMethodDef, 2).nameIndex_.index_;
+    size_t ne = merged.Row<MethodDefTableEntry>(tMethodDef, 3).nameIndex_.index_;
+    check(merged.String(writeLine) == "WriteLine" && line == writeLine + 5 && ne == writeLine + 7,
+          "suffixes point into the longer name");
+}
+
+static std::string Literal(int n)
+{
+    std::string literal = "literal " + std::to_string(n) + " ";
+    literal.resize(literal.size() + n % 1000, 'a' + n % 26);
+    return literal;
+}
+
+// a few megabytes of literals, so #US spans many segments of its pool
+static void ManyLiterals(PELib& peFile)
+{
+    HiThere(peFile);
+    for (int i = 0; i < 4000; i++)
+    {
+        Method* method = AddStaticMethod(peFile, "m" + std::to_string(i));
+        method->AddInstruction(new Instruction(Instruction::i_ldstr, new Operand(Literal(i), true)));
+        method->AddInstruction(new Instruction(Instruction::i_pop));
+        method->AddInstruction(new Instruction(Instruction::i_ret));
+    }
+}
+
+// entries keep their offsets and contents wherever a segment of the heap ends
+void testSegmentedHeaps()
+{
+    PEWriter writer(true, false, "");
+    std::vector<size_t> index;
+    for (int i = 0; i < 4000; i++)
+        index.push_back(writer.HashBlob((Byte*)Literal(i).c_str(), Literal(i).size()));
+    bool same = true;
+    for (int i = 0; i < 4000; i++)
+        same = same && writer.HashBlob((Byte*)Literal(i).c_str(), Literal(i).size()) == index[i];
+    check(same, "blobs are found in every segment");
+
+    std::vector<Byte> image = Image(ManyLiterals);
+    ImageReader reader(image);
+    check(reader.valid && reader.metadata.Find("#US")->size > 2 * 1024 * 1024, "big #US heap");
+    if (!reader.valid)
+        return;
+    int bad = 0;
+    for (size_t i = 2; i <= reader.metadata.rows[tMethodDef]; i++)
+    {
+        MethodDefTableEntry method = reader.metadata.Row<MethodDefTableEntry>(tMethodDef, i);
+        std::string literal = Literal(atoi(reader.metadata.String(method.nameIndex_.index_).c_str() + 1));
+        std::vector<Byte> us = reader.metadata.US(*(DWord*)&reader.Code(method.rva_)[1] & 0xffffff);
+        bool ok = us.size() == literal.size() * 2 + 3;
+        for (size_t j = 0; ok && j < literal.size(); j++)
+            ok = us[2 * j] == (Byte)literal[j] && !us[2 * j + 1];
+        if (!ok)
+            bad++;
+    }
+    check(reader.metadata.rows[tMethodDef] == 4001 && !bad, "every literal is intact");
+}
+
+// the UTF-16 of well formed UTF-8, followed by the \0 that ldstr literals carry
+static std::vector<Word> Utf16(const std::string& utf8)
+{
+    std::vector<Word> utf16;
+    for (size_t i = 0; i < utf8.size();)
+    {
+        unsigned c = (Byte)utf8[i];
+        int n = c < 0x80 ? 0 : c < 0xe0 ? 1 : c < 0xf0 ? 2 : 3;
+        c &= n ? 0x3f >> n : 0x7f;
+        for (int j = 1; j <= n; j++)
+            c = (c << 6) | (utf8[i + j] & 0x3f);
+        i += n + 1;
+        if (c >= 0x10000)
+        {
+            utf16.push_back(0xd800 + ((c - 0x10000) >> 10));
+            utf16.push_back(0xdc00 + ((c - 0x10000) & 0x3ff));
+        }
+        else
+        {
+            utf16.push_back(c);
+        }
+    }
+    utf16.push_back(0);
+    return utf16;
+}
+
+// literals transcoded from UTF-8 give the same #US entry, flag included, as their UTF-16
+void testUtf8Literals()
+{
+    std::vector<std::string> literals = { "", "a", "plain ASCII text that is longer than sixteen bytes",
+                                          "caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80 and \xce\xb1\xce\xb2\xce\xb3" };
+    // each special character at every position of a sixteen byte block, and right after one.
+    // The \0 of the literals counts as special as well, so it's the characters being
+    // copied through the vector path which is checked here, more than the flag
+    const char special[] = { 0x01, 0x08, 0x0e, 0x1f, 0x27, 0x2d, 0x7f };
+    for (char c : special)
+        for (int pos = 0; pos < 33; pos++)
+        {
+            std::string literal(40, 'x');
+            literal[pos] = c;
+            literals.push_back(literal);
+        }
+    // characters which are not special, next to the ones which are
+    const char plain[] = { 0x09, 0x0d, 0x20, 0x26, 0x28, 0x2c, 0x2e, 0x7e };
+    for (char c : plain)
+        literals.push_back(std::string(20, c) + "\xc3\xa9" + std::string(20, c));
+    int bad = 0;
+    for (auto&& literal : literals)
+    {
+        PEWriter writer(true, false, "");
+        size_t index = writer.HashUS(literal.c_str(), literal.size());
+        std::vector<Word> utf16 = Utf16(literal);
+        if (writer.HashUS(&utf16[0], utf16.size()) != index)
+        {
+            qCritical() << "literal" << literal.c_str();
+            bad++;
+        }
+    }
+    check(!bad, "UTF-8 literals match their UTF-16");
+}
+
+static void Signatures(PELib& peFile)
+{
+    HiThere(peFile);
+    AssemblyDef* assembly = peFile.WorkingAssembly();
+    MethodSignature* sig = new MethodSignature("wide", MethodSignature::Managed, assembly);
+    sig->ReturnType(new Type(Type::Void));
+    for (int i = 0; i < 200; i++)
+        sig->AddParam(new Param("p" + std::to_string(i), new Type(Type::i32)));
+    Method* method = new Method(sig, Qualifiers::Private | Qualifiers::Static | Qualifiers::HideBySig |
+                                         Qualifiers::CIL | Qualifiers::Managed);
+    Local* number = new Local("number", new Type(Type::i32));
+    Local* text = new Local("text", new Type(Type::string));
+    method->AddLocal(number);
+    method->AddLocal(text);
+    // the locals are ordered by their uses
+    method->AddInstruction(new Instruction(Instruction::i_ldloc, new Operand(number)));
+    method->AddInstruction(new Instruction(Instruction::i_pop));
+    method->AddInstruction(new Instruction(Instruction::i_ldloc, new Operand(number)));
+    method->AddInstruction(new Instruction(Instruction::i_pop));
+    method->AddInstruction(new Instruction(Instruction::i_ldloc, new Operand(text)));
+    method->AddInstruction(new Instruction(Instruction::i_pop));
+    method->AddInstruction(new Instruction(Instruction::i_ret));
+    assembly->Add(method);
+    assembly->Add(new Field("field", new Type(Type::i32), Qualifiers::Public | Qualifiers::Static));
+}
+
+// method, field and local signatures, with a parameter count that needs two bytes
+void testSignatures()
+{
+    std::vector<Byte> image = Image(Signatures);
+    ImageReader reader(image);
+    check(reader.valid && reader.metadata.rows[tMethodDef] == 2 && reader.metadata.rows[tField] == 1 &&
+              reader.metadata.rows[tStandaloneSig] == 1,
+          "method, field and locals");
+    if (!reader.valid || reader.metadata.rows[tMethodDef] != 2 || reader.metadata.rows[tField] != 1 ||
+        reader.metadata.rows[tStandaloneSig] != 1)
+        return;
+    MetadataReader& metadata = reader.metadata;
+    std::vector<Byte> sig = metadata.Blob(metadata.Row<MethodDefTableEntry>(tMethodDef, 2).signatureIndex_.index_);
+    std::vector<Byte> expected = { 0x00, 0x80, 0xc8, 0x01 };
+    expected.resize(4 + 200, 0x08);
+    check(sig == expected, "method signature");
+    sig = metadata.Blob(metadata.Row<FieldTableEntry>(tField, 1).signatureIndex_.index_);
+    check(sig == std::vector<Byte>({ 0x06, 0x08 }), "field signature");
+    sig = metadata.Blob(metadata.Row<StandaloneSigTableEntry>(tStandaloneSig, 1).signatureIndex_.index_);
+    check(sig == std::vector<Byte>({ 0x07, 0x02, 0x08, 0x0e }), "locals signature");
+}
+
+// a row of every table, with the table it belongs to
+typedef std::pair<std::shared_ptr<TableEntryBase>, int> Entry;
+static std::vector<Entry> Entries()
+{
+    std::vector<Entry> entries;
+    entries.push_back(Entry(std::make_shared<ModuleTableEntry>(), tModule));
+    entries.push_back(Entry(std::make_shared<TypeRefTableEntry>(), tTypeRef));
+    entries.push_back(Entry(std::make_shared<TypeDefTableEntry>(), tTypeDef));
+    entries.push_back(Entry(std::make_shared<FieldTableEntry>(), tField));
+    entries.push_back(Entry(std::make_shared<MethodDefTableEntry>(), tMethodDef));
+    entries.push_back(Entry(std::make_shared<ParamTableEntry>(), tParam));
+    entries.push_back(Entry(std::make_shared<InterfaceImplTableEntry>(), tInterfaceImpl));
+    entries.push_back(Entry(std::make_shared<MemberRefTableEntry>(), tMemberRef));
+    entries.push_back(Entry(std::make_shared<ConstantTableEntry>(), tConstant));
+    entries.push_back(Entry(std::make_shared<CustomAttributeTableEntry>(), tCustomAttribute));
+    entries.push_back(Entry(std::make_shared<FieldMarshalTableEntry>(), tFieldMarshal));
+    entries.push_back(Entry(std::make_shared<DeclSecurityTableEntry>(), tDeclSecurity));
+    entries.push_back(Entry(std::make_shared<ClassLayoutTableEntry>(), tClassLayout));
+    entries.push_back(Entry(std::make_shared<FieldLayoutTableEntry>(), tFieldLayout));
+    entries.push_back(Entry(std::make_shared<StandaloneSigTableEntry>(), tStandaloneSig));
+    entries.push_back(Entry(std::make_shared<EventMapTableEntry>(), tEventMap));
+    entries.push_back(Entry(std::make_shared<EventTableEntry>(), tEvent));
+    entries.push_back(Entry(std::make_shared<PropertyMapTableEntry>(), tPropertyMap));
+    entries.push_back(Entry(std::make_shared<PropertyTableEntry>(), tProperty));
+    entries.push_back(Entry(std::make_shared<MethodSemanticsTableEntry>(), tMethodSemantics));
+    entries.push_back(Entry(std::make_shared<MethodImplTableEntry>(), tMethodImpl));
+    entries.push_back(Entry(std::make_shared<ModuleRefTableEntry>(), tModuleRef));
+    entries.push_back(Entry(std::make_shared<TypeSpecTableEntry>(), tTypeSpec));
+    entries.push_back(Entry(std::make_shared<ImplMapTableEntry>(), tImplMap));
+    entries.push_back(Entry(std::make_shared<FieldRVATableEntry>(), tFieldRVA));
+    entries.push_back(Entry(std::make_shared<EncLogTableEntry>(), tEncLog));
+    entries.push_back(Entry(std::make_shared<EncMapTableEntry>(), tEncMap));
+    entries.push_back(Entry(std::make_shared<AssemblyDefTableEntry>(), tAssemblyDef));
+    entries.push_back(Entry(std::make_shared<AssemblyRefTableEntry>(), tAssemblyRef));
+    entries.push_back(Entry(std::make_shared<FileTableEntry>(), tFile));
+    entries.push_back(Entry(std::make_shared<ExportedTypeTableEntry>(), tExportedType));
+    entries.push_back(Entry(std::make_shared<ManifestResourceTableEntry>(), tManifestResource));
+    entries.push_back(Entry(std::make_shared<NestedClassTableEntry>(), tNestedClass));
+    entries.push_back(Entry(std::make_shared<GenericParamTableEntry>(), tGenericParam));
+    entries.push_back(Entry(std::make_shared<MethodSpecTableEntry>(), tMethodSpec));
+    entries.push_back(Entry(std::make_shared<GenericParamConstraintsTableEntry>(), tGenericParamConstraint));
+    return entries;
+}
+
+// every entry type reports its own table, the typed row storage depends on that
+void testTableIndexes()
+{
+    int mismatches = 0;
+    for (auto&& entry : Entries())
+        if (entry.first->TableIndex() != entry.second)
+        {
+            qCritical() << "entry for table" << entry.second << "reports" << entry.first->TableIndex();
+            mismatches++;
+        }
+    check(!mismatches, "entries report their own tables");
+
+    // exported types and resources used to share the resource table's storage
+    PEWriter writer(true, false, "");
+    writer.AddManifestResource("resource", ManifestResourceTableEntry::Public, resourceData, sizeof(resourceData));
+    Implementation implementation(Implementation::File, 0);
+    check(writer.AddTableEntry(ExportedTypeTableEntry(0, 0, writer.HashString("T"), 0, implementation)) == 1 &&
+              writer.NextTableIndex(tExportedType) == 2 && writer.NextTableIndex(tManifestResource) == 2,
+          "exported type and resource rows are kept apart");
+}
+
+// the row sizes of the schema are what the entries render and read, with indexes of either width
+void testSchema()
+{
+    struct
+    {
+        const char* name;
+        int table;
+        size_t count;
+    } cases[] = { { "small tables", -1, 0 },
+                  { "big #Strings", tString, 0x10000 },
+                  { "big #Blob", tBlob, 0x10000 },
+                  { "big #GUID", tGUID, 0x10000 },
+                  { "TypeDefOrRef below its limit", tTypeDef, 0x3fff },
+                  { "TypeDefOrRef at its limit", tTypeDef, 0x4000 },
+                  { "HasCustomAttribute at its limit", tMethodDef, 0x800 },
+                  { "big Field table", tField, 0x10000 },
+                  { "all big", MaxTables + ExtraIndexes, 0x1000000 } };
+    for (auto&& test : cases)
+    {
+        size_t sizes[MaxTables + ExtraIndexes];
+        for (int i = 0; i < MaxTables + ExtraIndexes; i++)
+            sizes[i] = test.table == MaxTables + ExtraIndexes ? test.count : 1;
+        if (test.table >= 0 && test.table < MaxTables + ExtraIndexes)
+            sizes[test.table] = test.count;
+        MetaSchema schema(sizes);
+        int bad = 0;
+        for (auto&& entry : Entries())
+        {
+            // the writer renders a method's rva from its body
+            PEMethod method(false, 0, 1, 8, 0, 1, 0);
+            if (entry.second == tMethodDef)
+                entry.first = std::make_shared<MethodDefTableEntry>(&method, 0, 0, 0, 0, 0);
+            Byte row[256] = { 0 };
+            if (entry.first->Render(schema, row) != schema.rowSize[entry.second] ||
+                entry.first->Get(sizes, row) != schema.rowSize[entry.second])
+            {
+                qCritical() << test.name << ": table" << entry.second;
+                bad++;
+            }
+        }
+        check(!bad, "rows render and read back at the schema's size");
+    }
+    size_t sizes[MaxTables + ExtraIndexes] = { 0 };
+    sizes[tTypeDef] = 0x3fff;
+    size_t small = MetaSchema(sizes).rowSize[tTypeDef];
+    sizes[tTypeDef] = 0x4000;
+    check(MetaSchema(sizes).rowSize[tTypeDef] == small + 2, "TypeDefOrRef widens at 0x4000 type definitions");
+}
+
+// HotReload adds an attribute on the assembly before the vararg method adds one on its last param
+static void AttributesOutOfOrder(PELib& peFile)
+{
+    peFile.HotReload(true);
+    HiThere(peFile);
+    Method* method = AddStaticMethod(peFile, "varargs", new Type(Type::i32));
+    method->Signature()->SetVarargFlag();
+    method->AddInstruction(new Instruction(Instruction::i_ret));
+}
+
+// the tables ECMA-335 wants sorted are in order of their keys, and flagged as sorted
+void testSortedTables()
+{
+    std::vector<Byte> image = Image(AttributesOutOfOrder);
+    ImageReader reader(image);
+    MetadataReader& metadata = reader.metadata;
+    int unsorted = 0;
+    for (auto&& entry : Entries())
+    {
+        int n = entry.second;
+        if (!(metadata.maskSorted & (1ULL << n)))
+            continue;
+        ulonglong last = 0;
+        for (size_t i = 0; i < metadata.rows[n]; i++)
+        {
+            entry.first->Get(metadata.sizes, const_cast<Byte*>(metadata.tables[n] + i * metadata.rowSize[n]));
+            if (entry.first->SortKey() < last)
+            {
+                qCritical() << "table" << n << "row" << i + 1 << "is out of order";
+                unsorted++;
+            }
+            last = entry.first->SortKey();
+        }
+    }
+    check(reader.valid && metadata.rows[tCustomAttribute] == 2, "attributes on the assembly and on a param");
+    check(!unsorted, "sorted tables are in order");
+    CustomAttributeTableEntry first = metadata.Row<CustomAttributeTableEntry>(tCustomAttribute, 1);
+    check(first.parentIndex_.tag_ == CustomAttribute::ParamDef, "the attribute on the param comes first");
+    check((metadata.maskSorted & (1ULL << tCustomAttribute)) && (metadata.maskSorted & (1ULL << tConstant)) &&
+              (metadata.maskSorted & (1ULL << tInterfaceImpl)),
+          "sorted tables are flagged");
+}
+
+// each call makes its own Console class and WriteLine signature, and two functions come from one dll
+static void SameReferences(PELib& peFile)
+{
+    Method* methMain = AddMain(peFile);
+    for (int i = 0; i < 2; i++)
+    {
+        methMain->AddInstruction(new Instruction(Instruction::i_ldstr, new Operand("Hi there!", true)));
+        methMain->AddInstruction(new Instruction(Instruction::i_call, new Operand(new MethodName(WriteLine(peFile)))));
+    }
+    methMain->AddInstruction(new Instruction(Instruction::i_ret));
+    for (const char* name : { "puts", "putchar" })
+    {
+        MethodSignature* sig = new MethodSignature(name, 0, peFile.WorkingAssembly());
+        sig->ReturnType(new Type(Type::i32));
+        sig->AddParam(new Param("p", new Type(Type::i32)));
+        peFile.AddPInvokeReference(sig, "msvcrt.dll", true);
+    }
+}
+
+// references that describe the same type, member or module share one row
+void testReferenceInterning()
+{
+    std::vector<Byte> single = Image(HiThere);
+    std::vector<Byte> image = Image(SameReferences);
+    ImageReader one(single), reader(image);
+    check(one.valid && reader.valid, "images are readable");
+    if (!one.valid || !reader.valid)
+        return;
+    check(reader.metadata.rows[tTypeRef] == one.metadata.rows[tTypeRef], "equal type references share a TypeRef");
+    check(reader.metadata.rows[tMemberRef] == one.metadata.rows[tMemberRef], "equal callees share a MemberRef");
+    check(reader.metadata.rows[tModuleRef] == 1, "functions from one dll share a ModuleRef");
+    check(reader.metadata.rows[tAssemblyRef] == one.metadata.rows[tAssemblyRef], "one mscorlib reference");
+    // the functions from the dll are dumped before the assembly
+    std::vector<Byte> main;
+    for (size_t i = 1; i <= reader.metadata.rows[tMethodDef]; i++)
+    {
+        MethodDefTableEntry method = reader.metadata.Row<MethodDefTableEntry>(tMethodDef, i);
+        if (reader.metadata.String(method.nameIndex_.index_) == "$Main")
+            main = reader.Code(method.rva_);
+    }
+    check(main.size() == 21 && main[5] == 0x28 && main[15] == 0x28 && main[9] == tMemberRef &&
+              *(DWord*)&main[6] == *(DWord*)&main[16],
+          "both calls have the same MemberRef token");
+}
+
+// two methods with the same types of locals under other names, and one with other types
+static void SameLocals(PELib& peFile)
+{
+    HiThere(peFile);
+    const char* names[][2] = { { "a", "b" }, { "c", "d" } };
+    for (int i = 0; i < 3; i++)
+    {
+        Method* method = AddStaticMethod(peFile, std::string("locals") + char('0' + i));
+        if (i < 2)
+        {
+            method->AddLocal(new Local(names[i][0], new Type(Type::i32)));
+            method->AddLocal(new Local(names[i][1], new Type(Type::object)));
+        }
+        else
+            method->AddLocal(new Local("s", new Type(Type::string)));
+        method->AddInstruction(new Instruction(Instruction::i_ret));
+    }
+}
+
+// methods whose locals have the same types share one local signature
+void testLocalSignatures()
+{
+    std::vector<Byte> image = Image(SameLocals);
+    ImageReader reader(image);
+    check(reader.valid && reader.metadata.rows[tMethodDef] == 4, "four methods");
+    if (!reader.valid || reader.metadata.rows[tMethodDef] != 4)
+        return;
+    check(reader.metadata.rows[tStandaloneSig] == 2, "one StandaloneSig row per set of local types");
+    DWord token[3];
+    for (int i = 0; i < 3; i++)
+    {
+        // a body with locals has a fat header, which holds the token of the local signature
+        const Byte* body = reader.At(reader.metadata.Row<MethodDefTableEntry>(tMethodDef, i + 2).rva_);
+        token[i] = body && (body[0] & 3) == 3 ? *(DWord*)(body + 8) : 0;
+    }
+    check((token[0] >> 24) == tStandaloneSig && token[0] == token[1], "equal locals share a token");
+    check((token[2] >> 24) == tStandaloneSig && token[2] != token[0], "other locals have their own token");
+    StandaloneSigTableEntry sig = reader.metadata.Row<StandaloneSigTableEntry>(tStandaloneSig, token[0] & 0xffffff);
+    std::vector<Byte> blob = reader.metadata.Blob(sig.signatureIndex_.index_);
+    check(blob.size() == 4 && blob[0] == 7 && blob[1] == 2 && blob[2] == 8 && blob[3] == 0x1c, "local signature bytes");
+}
+
+// enough literals for offsets into #US to take four bytes, in bodies small enough for tiny headers
+static void LongLiterals(PELib& peFile)
+{
+    HiThere(peFile);
+    for (int i = 0; i < 100; i++)
+    {
+        Method* method = AddStaticMethod(peFile, "m" + std::to_string(i));
+        method->AddInstruction(new Instruction(Instruction::i_ldstr, new Operand(Literal(900 + i), true)));
+        method->AddInstruction(new Instruction(Instruction::i_pop));
+        method->AddInstruction(new Instruction(Instruction::i_ret));
+        method->MaxStack(1);
+    }
+}
+
+static const PEStatistics::Heap* FindHeap(const PEStatistics& statistics, const std::string& name)
+{
+    for (auto&& heap : statistics.heaps)
+        if (heap.name == name)
+            return &heap;
+    return nullptr;
+}
+
+// the statistics agree with the image they describe
+void testStatistics()
+{
+    std::vector<Byte> image;
+    PEStatistics statistics;
+    {
+        PELib peFile("test3", PELib::ilonly);
+        SameLocals(peFile);
+        check(peFile.DumpOutputImage("test3.exe", PELib::peexe, false, image), "image is written");
+        statistics = peFile.Statistics();
+    }
+    ImageReader reader(image);
+    check(reader.valid, "image is readable");
+    if (!reader.valid)
+        return;
+    size_t tables = 0, bad = 0;
+    for (int n = 0; n < MaxTables; n++)
+        if (reader.metadata.rows[n])
+            tables++;
+    for (auto&& table : statistics.tables)
+        if (table.rows != reader.metadata.rows[table.table] ||
+            table.bytes != table.rows * reader.metadata.rowSize[table.table])
+        {
+            qCritical() << table.name << table.rows << table.bytes;
+            bad++;
+        }
+    check(statistics.tables.size() == tables && !bad, "rows and bytes of every table");
+    for (const char* name : { "#Strings", "#US", "#GUID", "#Blob" })
+    {
+        const PEStatistics::Heap* heap = FindHeap(statistics, name);
+        const MetadataReader::Stream* stream = reader.metadata.Find(name);
+        // streams are padded to four bytes
+        check(heap && stream && heap->bytes <= stream->size && stream->size < heap->bytes + 4 && !heap->wide,
+              "heap size");
+    }
+    const PEStatistics::Heap* blob = FindHeap(statistics, "#Blob");
+    check(blob->shared >= 1 && blob->shared < blob->added, "the shared local signature is counted");
+    bool wide = false;
+    for (auto&& index : statistics.indexes)
+        wide = wide || index.wide || index.trigger;
+    check(statistics.indexes.size() == MaxIndexKinds && !wide, "every index takes two bytes");
+    // without MaxStack the stack is deeper than a tiny header allows
+    check(!statistics.tinyMethods && statistics.fatMethods == 4 && statistics.fatBytes >= 4 * 13,
+          "bodies with fat headers");
+
+    {
+        PELib peFile("test3", PELib::ilonly);
+        LongLiterals(peFile);
+        check(peFile.DumpOutputImage("test3.exe", PELib::peexe, false, image), "image with long literals is written");
+        statistics = peFile.Statistics();
+    }
+    check(FindHeap(statistics, "#US")->wide && !FindHeap(statistics, "#Strings")->wide, "only #US is wide");
+    int wideIndexes = 0;
+    for (auto&& index : statistics.indexes)
+        if (index.wide)
+        {
+            wideIndexes++;
+            check(std::string(index.name) == "#US" && index.trigger && std::string(index.trigger) == "#US",
+                  "#US is too large for itself");
+        }
+    check(wideIndexes == 1, "one kind of index is wide");
+    // a header byte and ldstr, pop, ret, tiny bodies need no alignment
+    check(statistics.tinyMethods == 100 && statistics.tinyBytes == 100 * 8 && statistics.fatMethods == 1,
+          "bodies with tiny headers");
+}
+
+// main of test2's module under another name
+static void Renamed(PELib& peFile)
+{
+    AssemblyDef* assembly = peFile.WorkingAssembly();
+    MethodSignature* sigMain = new MethodSignature("Main", MethodSignature::Managed, assembly);
+    sigMain->ReturnType(new Type(Type::Void));
+    Method* methMain = new Method(sigMain, Qualifiers::Private | Qualifiers::Static | Qualifiers::HideBySig |
+                                               Qualifiers::CIL | Qualifiers::Managed, true);
+    assembly->Add(methMain);
+    methMain->AddInstruction(new Instruction(Instruction::i_ldstr, new Operand("Hi there!", true)));
+    methMain->AddInstruction(new Instruction(Instruction::i_call, new Operand(new MethodName(WriteLine(peFile)))));
+    methMain->AddInstruction(new Instruction(Instruction::i_ret));
+}
+
+static bool Delta(PEBaseline& baseline, Module module, std::vector<Byte>& metadata, std::vector<Byte>& il)
+{
+    PELib peFile("test3", PELib::ilonly);
+    module(peFile);
+    return peFile.DumpDelta(baseline, metadata, il);
+}
+
+// a delta holds the changed body and its literal, and becomes the baseline of the next one
+void testDelta()
+{
+    std::shared_ptr<PEBaseline> baseline;
+    size_t usSize = 0;
+    {
+        PELib peFile("test3", PELib::ilonly);
+        peFile.HotReload(true);
+        HiThere(peFile);
+        std::vector<Byte> image;
+        check(peFile.DumpOutputImage("test3.exe", PELib::peexe, false, image), "baseline is written");
+        baseline = peFile.Baseline();
+        for (auto&& heap : peFile.Statistics().heaps)
+            if (std::string(heap.name) == "#US")
+                usSize = heap.bytes;
+    }
+    check(baseline && usSize, "the image is the baseline");
+    if (!baseline)
+        return;
+    std::vector<Byte> metadata, il;
+    check(Delta(*baseline, HiThereAgain, metadata, il), "delta is written");
+    MetadataReader reader(&metadata[0], metadata.size());
+    check(reader.valid && reader.Find("#-") && (reader.heapSizes & 0x20), "delta has an uncompressed table stream");
+    if (!reader.valid)
+        return;
+    check(reader.Row<ModuleTableEntry>(tModule, 1).generation_ == 1, "first generation");
+    check(reader.rows[tMethodDef] == 1 && reader.rows[tEncMap] == 1 &&
+              reader.Row<EncMapTableEntry>(tEncMap, 1).token_ == ((tMethodDef << 24) | 1),
+          "only main changed");
+    bool logged = false;
+    for (size_t i = 1; i <= reader.rows[tEncLog]; i++)
+        logged = logged || reader.Row<EncLogTableEntry>(tEncLog, i).token_ == ((tMethodDef << 24) | 1);
+    check(logged, "the change of main is logged");
+    MethodDefTableEntry method = reader.Row<MethodDefTableEntry>(tMethodDef, 1);
+    const bool inDelta = method.rva_ > 0 && size_t(method.rva_) + 17 < il.size();
+    check(inDelta && il[method.rva_ + 12] == 0x72, "body is in the IL delta");
+    if (!inDelta)
+        return;
+    // offsets go on from the baseline's heap padded to four bytes, where the delta
+    // heap starts with a 0 byte
+    DWord token = *(DWord*)&il[method.rva_ + 13];
+    const size_t start = (usSize + 3) & ~3;
+    std::vector<Byte> us = reader.US((token & 0xffffff) - start);
+    check((token >> 24) == 0x70 && (token & 0xffffff) == start + 1 && us.size() == 33 && us[0] == 'H' &&
+              us[28] == '!',
+          "new literal is in the delta");
+
+    // the baseline moved on, so the same module again changes nothing
+    check(Delta(*baseline, HiThereAgain, metadata, il), "second delta is written");
+    reader = MetadataReader(&metadata[0], metadata.size());
+    check(reader.valid && reader.Row<ModuleTableEntry>(tModule, 1).generation_ == 2 && !reader.rows[tMethodDef] &&
+              !reader.rows[tEncMap],
+          "second generation has no changes");
+
+    bool thrown = false;
+    try
+    {
+        Delta(*baseline, Renamed, metadata, il);
+    }
+    catch (PELibError&)
+    {
+        thrown = true;
+    }
+    check(thrown, "changing a row is not supported");
+    check(Delta(*baseline, HiThereAgain, metadata, il), "delta after the failed one is written");
+    reader = MetadataReader(&metadata[0], metadata.size());
+    check(reader.valid && reader.Row<ModuleTableEntry>(tModule, 1).generation_ == 3,
+          "the failed delta left the baseline as it was");
+}
+
+// a generator per thread builds the same signatures as one generator on its own
+void testSignatureThreads()
+{
+    // some signatures fit the inline buffer of a generator, the longer ones make it grow
+    std::vector<std::unique_ptr<MethodSignature>> signatures;
+    const Type::BasicType types[] = { Type::i32, Type::string, Type::object, Type::r64 };
+    for (int i = 0; i < 40; i++)
+    {
+        signatures.push_back(std::unique_ptr<MethodSignature>(
+            new MethodSignature("f" + std::to_string(i), MethodSignature::Managed, nullptr)));
+        signatures.back()->ReturnType(new Type(types[i % 4]));
+        for (int j = 0; j < i * i % 150; j++)
+            signatures.back()->AddParam(new Param("p", new Type(types[(i + j) % 4])));
+    }
+    auto generate = [&signatures]() {
+        SignatureGenerator generator;
+        std::vector<std::vector<Byte>> result;
+        for (int k = 0; k < 50; k++)
+            for (auto&& signature : signatures)
+            {
+                size_t sz;
+                Byte* sig = generator.MethodDefSig(signature.get(), sz);
+                result.push_back(std::vector<Byte>(sig, sig + sz));
+            }
+        return result;
+    };
+    std::vector<std::vector<Byte>> expected = generate();
+    std::vector<std::future<std::vector<std::vector<Byte>>>> threads;
+    for (int i = 0; i < 4; i++)
+        threads.push_back(std::async(std::launch::async, generate));
+    bool same = true;
+    for (auto&& thread : threads)
+        same = thread.get() == expected && same;
+    check(same, "signatures built on several threads");
+    check(expected[39].size() == 2 + 1 + 39 * 39 % 150 && expected[39][1] == 39 * 39 % 150,
+          "long signature is complete");
+}
+
+// a static property and an instance property with an index
+static void Properties(PELib& peFile)
+{
+    HiThere(peFile);
+    Class* holder = new Class("Holder", Qualifiers::Public, -1, -1);
+    peFile.WorkingAssembly()->Add(holder);
+    std::vector<Type*> noIndex;
+    Property* count = new Property(peFile, "Count", new Type(Type::i32), noIndex, false, nullptr);
+    count->Instance(false);
+    count->Getter()->AddInstruction(new Instruction(Instruction::i_ldc_i4, new Operand(3, Operand::i32)));
+    count->Getter()->AddInstruction(new Instruction(Instruction::i_ret));
+    holder->Add(count);
+    std::vector<Type*> index(1, new Type(Type::i32));
+    Property* item = new Property(peFile, "Item", new Type(Type::string), index, false, nullptr);
+    item->Getter()->AddInstruction(new Instruction(Instruction::i_ldnull));
+    item->Getter()->AddInstruction(new Instruction(Instruction::i_ret));
+    holder->Add(item);
+}
+
+// property signatures are PROPERTY with HASTHIS for instance properties, then the
+// count of indexes, the type and the types of the indexes
+void testPropertySignatures()
+{
+    std::vector<Byte> image = Image(Properties);
+    ImageReader reader(image);
+    check(reader.valid && reader.metadata.rows[tProperty] == 2, "two properties");
+    if (!reader.valid || reader.metadata.rows[tProperty] != 2)
+        return;
+    PropertyTableEntry count = reader.metadata.Row<PropertyTableEntry>(tProperty, 1);
+    PropertyTableEntry item = reader.metadata.Row<PropertyTableEntry>(tProperty, 2);
+    check(reader.metadata.String(count.name_.index_) == "Count" && reader.metadata.String(item.name_.index_) == "Item",
+          "property names");
+    check(reader.metadata.Blob(count.propertyType_.index_) == std::vector<Byte>({ 0x08, 0, 0x08 }),
+          "static property signature");
+    check(reader.metadata.Blob(item.propertyType_.index_) == std::vector<Byte>({ 0x28, 1, 0x0e, 0x08 }),
+          "instance property signature");
+}
+
+int main()
+{
+    testSingleBuffer();
+    testMappedFile();
+    testStrongNameHash();
+    testParallelRegions();
+    testFailedOutput();
+    testDeterministic();
+    testKeepIdentical();
+    testAsyncOutput();
+    testPE32Plus();
+    testResources();
+    testBlobInterning();
+    testUSInterning();
+    testStringInterning();
+    testStringSuffixes();
+    testSegmentedHeaps();
+    testUtf8Literals();
+    testSignatures();
+    testTableIndexes();
+    testSchema();
+    testSortedTables();
+    testReferenceInterning();
+    testLocalSignatures();
+    testStatistics();
+    testDelta();
+    testSignatureThreads();
+    testPropertySignatures();
+    if (failures)
+        qCritical() << failures << "checks failed";
+    else
+        qDebug() << "all checks passed";
+    return failures != 0;
+}